@@ -0,0 +1,104 @@
+#include "alignedBuffer.h"
+
+#include <bit>
+#include <new>
+#include <utility>
+
+namespace Gerk
+{
+	namespace
+	{
+		char *allocate(size_t bytes, size_t alignment)
+		{
+			return (char *)::operator new(bytes, std::align_val_t(alignment));
+		}
+
+		void deallocate(char *memory, size_t alignment)
+		{
+			::operator delete(memory, std::align_val_t(alignment));
+		}
+
+		size_t roundUp(size_t bytes, size_t alignment)
+		{
+			return (bytes + alignment - 1) & ~(alignment - 1);
+		}
+	} // namespace
+
+	AlignedBuffer::AlignedBuffer(size_t bytes, size_t alignment)
+		: memory(allocate(roundUp(bytes, alignment), alignment)), capacity(roundUp(bytes, alignment)), alignment(alignment)
+	{
+	}
+
+	AlignedBuffer::AlignedBuffer(AlignedBuffer &&other)
+		: memory(std::exchange(other.memory, nullptr)), capacity(other.capacity), alignment(other.alignment), owner(other.owner)
+	{
+	}
+
+	AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other)
+	{
+		if (this != &other)
+		{
+			this->~AlignedBuffer();
+			memory = std::exchange(other.memory, nullptr);
+			capacity = other.capacity;
+			alignment = other.alignment;
+			owner = other.owner;
+		}
+		return *this;
+	}
+
+	AlignedBuffer::~AlignedBuffer()
+	{
+		if (!memory)
+			return;
+		if (owner)
+			owner->release(memory, capacity, alignment);
+		else
+			deallocate(memory, alignment);
+		memory = nullptr;
+	}
+
+	AlignedBufferPool::~AlignedBufferPool()
+	{
+		for (const Free &buffer : free)
+			deallocate(buffer.memory, buffer.alignment);
+	}
+
+	AlignedBuffer AlignedBufferPool::acquire(size_t bytes, size_t alignment)
+	{
+		size_t capacity = std::bit_ceil(roundUp(bytes ? bytes : 1, alignment));
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			for (size_t i = 0; i < free.size(); i++)
+			{
+				if (free[i].capacity == capacity && free[i].alignment == alignment)
+				{
+					char *memory = free[i].memory;
+					free[i] = free.back();
+					free.pop_back();
+					return AlignedBuffer(memory, capacity, alignment, this);
+				}
+			}
+		}
+		return AlignedBuffer(allocate(capacity, alignment), capacity, alignment, this);
+	}
+
+	void AlignedBufferPool::release(char *memory, size_t capacity, size_t alignment)
+	{
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			if (free.size() < maxCached)
+			{
+				free.push_back({memory, capacity, alignment});
+				return;
+			}
+		}
+		deallocate(memory, alignment);
+	}
+
+	AlignedBufferPool &AlignedBufferPool::shared()
+	{
+		static AlignedBufferPool pool;
+		return pool;
+	}
+} // namespace Gerk
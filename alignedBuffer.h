@@ -0,0 +1,72 @@
+#ifndef INCLUDE_GERK_ALIGNED_BUFFER
+#define INCLUDE_GERK_ALIGNED_BUFFER
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace Gerk
+{
+	class AlignedBufferPool;
+
+	// Heap memory aligned for O_DIRECT transfers, handed back to its pool when destroyed
+	class AlignedBuffer
+	{
+		char *memory = nullptr;
+		size_t capacity = 0;
+		size_t alignment = 0;
+		AlignedBufferPool *owner = nullptr;
+
+		friend class AlignedBufferPool;
+		AlignedBuffer(char *memory, size_t capacity, size_t alignment, AlignedBufferPool *owner)
+			: memory(memory), capacity(capacity), alignment(alignment), owner(owner) {}
+
+	public:
+		AlignedBuffer() = default;
+		// Allocates outside of any pool
+		AlignedBuffer(size_t bytes, size_t alignment);
+		AlignedBuffer(AlignedBuffer &&other);
+		AlignedBuffer &operator=(AlignedBuffer &&other);
+		~AlignedBuffer();
+
+		char *data() const { return memory; }
+		// At least the requested size, rounded up to a multiple of the alignment
+		size_t size() const { return capacity; }
+		explicit operator bool() const { return memory; }
+	};
+
+	// Keeps released AlignedBuffers for reuse so O_DIRECT bounce buffers don't hit the allocator on every call
+	// Thread safe
+	class AlignedBufferPool
+	{
+		struct Free
+		{
+			char *memory;
+			size_t capacity;
+			size_t alignment;
+		};
+
+		std::mutex mutex;
+		std::vector<Free> free;
+		size_t maxCached;
+
+		friend class AlignedBuffer;
+		void release(char *memory, size_t capacity, size_t alignment);
+
+	public:
+		// Holds on to at most maxCached idle buffers, frees the rest
+		explicit AlignedBufferPool(size_t maxCached = 64) : maxCached(maxCached) {}
+		~AlignedBufferPool();
+
+		AlignedBufferPool(const AlignedBufferPool &) = delete;
+		AlignedBufferPool &operator=(const AlignedBufferPool &) = delete;
+
+		// Sizes are rounded up to a power of two so buffers of similar size are reused, alignment must be a power of two
+		AlignedBuffer acquire(size_t bytes, size_t alignment);
+
+		// Pool used by File for its O_DIRECT bounce buffers
+		static AlignedBufferPool &shared();
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_ALIGNED_BUFFER
@@ -0,0 +1,174 @@
+#include "appendLog.h"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <sys/uio.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		size_t framingBytes(AppendLog::Framing framing)
+		{
+			switch (framing)
+			{
+			case AppendLog::Framing::Newline:
+				return 1;
+			case AppendLog::Framing::LengthPrefix:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+	} // namespace
+
+	AppendLog::AppendLog(File &file, Options options)
+		: file(file), options(options)
+	{
+		this->options.capacity = std::bit_ceil(std::max<size_t>(options.capacity, 64));
+		ring = std::make_unique<char[]>(this->options.capacity);
+		mask = this->options.capacity - 1;
+		drainer = std::thread(&AppendLog::run, this);
+	}
+
+	AppendLog::~AppendLog()
+	{
+		{
+			std::lock_guard<std::mutex> guard(doorbellMutex);
+			stopping.store(true);
+		}
+		doorbell.notify_one();
+		drainer.join();
+	}
+
+	void AppendLog::throwIfFailed()
+	{
+		if (failed.load(std::memory_order_acquire))
+			std::rethrow_exception(failure);
+	}
+
+	void AppendLog::copyIn(uint64_t position, const char *data, size_t bytes)
+	{
+		size_t offset = position & mask;
+		size_t first = std::min(bytes, options.capacity - offset);
+		std::memcpy(ring.get() + offset, data, first);
+		std::memcpy(ring.get(), data + first, bytes - first);
+	}
+
+	bool AppendLog::append(std::string_view record)
+	{
+		throwIfFailed();
+
+		const size_t framing = framingBytes(options.framing);
+		const uint64_t size = record.size() + framing;
+		if (size > options.capacity || (options.framing == Framing::LengthPrefix && record.size() > UINT32_MAX))
+			throw std::length_error("AppendLog record larger than the ring");
+
+		uint64_t position;
+		if (options.overflow == Overflow::Fail)
+		{
+			position = reserved.load(std::memory_order_relaxed);
+			do
+			{
+				if (position + size - drained.load(std::memory_order_acquire) > options.capacity)
+					return false;
+			} while (!reserved.compare_exchange_weak(position, position + size, std::memory_order_relaxed));
+		}
+		else
+		{
+			position = reserved.fetch_add(size, std::memory_order_relaxed);
+			// Back-pressure, wait for the drainer to free the space this record lands in
+			for (uint64_t done = drained.load(std::memory_order_acquire); position + size - done > options.capacity; done = drained.load(std::memory_order_acquire))
+			{
+				throwIfFailed();
+				drained.wait(done);
+			}
+		}
+
+		if (options.framing == Framing::LengthPrefix)
+		{
+			uint32_t length = (uint32_t)record.size();
+			char prefix[4] = {(char)length, (char)(length >> 8), (char)(length >> 16), (char)(length >> 24)};
+			copyIn(position, prefix, 4);
+			copyIn(position + 4, record.data(), record.size());
+		}
+		else
+		{
+			copyIn(position, record.data(), record.size());
+			if (options.framing == Framing::Newline)
+				copyIn(position + record.size(), "\n", 1);
+		}
+
+		// Publish in reservation order so the drainer only ever sees a complete prefix
+		for (uint64_t ready = committed.load(std::memory_order_acquire); ready != position; ready = committed.load(std::memory_order_acquire))
+		{
+			throwIfFailed();
+			committed.wait(ready);
+		}
+		// Sequentially consistent against the drainer going idle, one of the two always sees the other
+		committed.store(position + size);
+		committed.notify_all();
+		if (drainerIdle.load())
+		{
+			std::lock_guard<std::mutex> guard(doorbellMutex);
+			doorbell.notify_one();
+		}
+		return true;
+	}
+
+	void AppendLog::flush()
+	{
+		uint64_t target = reserved.load(std::memory_order_acquire);
+		for (uint64_t done = drained.load(std::memory_order_acquire); done < target; done = drained.load(std::memory_order_acquire))
+		{
+			throwIfFailed();
+			drained.wait(done);
+		}
+		throwIfFailed();
+	}
+
+	void AppendLog::run()
+	{
+		uint64_t done = 0;
+		while (true)
+		{
+			uint64_t ready = committed.load(std::memory_order_acquire);
+			if (ready == done)
+			{
+				if (stopping.load() && reserved.load() == done)
+					return;
+
+				std::unique_lock<std::mutex> guard(doorbellMutex);
+				drainerIdle.store(true);
+				doorbell.wait(guard, [&]
+							  { return committed.load() != done || stopping.load(); });
+				drainerIdle.store(false);
+				continue;
+			}
+
+			size_t offset = done & mask;
+			size_t bytes = ready - done;
+			size_t first = std::min(bytes, options.capacity - offset);
+			iovec pieces[2] = {{ring.get() + offset, first}, {ring.get(), bytes - first}};
+			try
+			{
+				file.write(std::span<const iovec>(pieces, bytes == first ? 1 : 2));
+				file.flush();
+			}
+			catch (...)
+			{
+				failure = std::current_exception();
+				failed.store(true, std::memory_order_release);
+				// Jumping drained to the end wakes every producer and flush() waiting for space, they find failed set
+				drained.store(UINT64_MAX, std::memory_order_release);
+				drained.notify_all();
+				return;
+			}
+
+			done = ready;
+			drained.store(done, std::memory_order_release);
+			drained.notify_all();
+		}
+	}
+} // namespace Gerk
@@ -0,0 +1,96 @@
+#ifndef INCLUDE_GERK_APPEND_LOG
+#define INCLUDE_GERK_APPEND_LOG
+
+#include "file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+namespace Gerk
+{
+	// Multi-producer append log in front of a File, replacing lock(); write(); unlock(); from many threads
+	//
+	// Producers reserve space in a shared ring buffer with one atomic fetch_add and copy their record in parallel,
+	// a single drainer thread turns whatever has been published into large writes to the File
+	class AppendLog
+	{
+	public:
+		enum class Framing
+		{
+			// Records are written back to back as given
+			None,
+			// A '\n' is added after every record
+			Newline,
+			// Every record is preceded by its length as a 32 bit little endian integer
+			LengthPrefix,
+		};
+
+		enum class Overflow
+		{
+			// append() waits for the drainer to make room
+			Block,
+			// append() returns false straight away when the record doesn't fit
+			Fail,
+		};
+
+		struct Options
+		{
+			// Rounded up to a power of two, the largest framed record that can be appended
+			size_t capacity = 4 << 20;
+			Framing framing = Framing::None;
+			Overflow overflow = Overflow::Block;
+		};
+
+	private:
+		File &file;
+		Options options;
+		std::unique_ptr<char[]> ring;
+		size_t mask;
+
+		// Positions grow forever, ring offsets are position & mask
+		// Kept on separate cache lines, producers hammer reserved while the drainer owns drained
+		alignas(64) std::atomic<uint64_t> reserved = 0;
+		// Everything before this has been copied in and can be drained, producers publish in reservation order
+		alignas(64) std::atomic<uint64_t> committed = 0;
+		alignas(64) std::atomic<uint64_t> drained = 0;
+
+		// The drainer sleeps on a condition variable, producers only take the mutex to ring it while it is idle
+		std::mutex doorbellMutex;
+		std::condition_variable doorbell;
+		std::atomic<bool> drainerIdle = false;
+
+		std::atomic<bool> stopping = false;
+		std::atomic<bool> failed = false;
+		std::exception_ptr failure;
+
+		std::thread drainer;
+
+		void run();
+		void copyIn(uint64_t position, const char *data, size_t bytes);
+		void throwIfFailed();
+
+	public:
+		AppendLog(File &file, Options options);
+		explicit AppendLog(File &file) : AppendLog(file, Options()) {}
+		// Drains everything appended so far before returning
+		~AppendLog();
+
+		AppendLog(const AppendLog &) = delete;
+		AppendLog &operator=(const AppendLog &) = delete;
+
+		// Safe from any number of threads, returns false only with Overflow::Fail when the ring is full
+		// Throws std::length_error for a record that can never fit and rethrows a failed write of the drainer
+		bool append(std::string_view record);
+
+		// Waits until every record appended before the call has been written to the File
+		void flush();
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_APPEND_LOG
@@ -0,0 +1,203 @@
+#include "asyncFile.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		// std::function needs a copyable callable, so the promise is shared with the callback
+		std::pair<std::future<ssize_t>, IoEngine::Callback> promised()
+		{
+			auto promise = std::make_shared<std::promise<ssize_t>>();
+			auto future = promise->get_future();
+			return {std::move(future), [promise](ssize_t result)
+					{ promise->set_value(result); }};
+		}
+
+		// Suspends until the request issued by start completes, resuming with its result
+		struct Completion
+		{
+			std::function<void(IoEngine::Callback)> start;
+			ssize_t result = 0;
+
+			bool await_ready() { return false; }
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				start([this, handle](ssize_t value)
+					  {
+						  result = value;
+						  handle.resume(); });
+			}
+			ssize_t await_resume() { return result; }
+		};
+
+		void throwIfFailed(ssize_t result, const char *what)
+		{
+			if (result < 0)
+				throw std::system_error((int)-result, std::generic_category(), what);
+		}
+	} // namespace
+
+	AsyncFile::AsyncFile(IoEngine &engine, File &&file)
+		: engine(engine), file(std::move(file)), delimiter(this->file.lineDelimiter())
+	{
+		// Anything still buffered would land after the asynchronous requests
+		this->file.flush();
+		if (size_t buffered = this->file.buffered())
+		{
+			// The read-ahead goes back to a file that can seek, pipes and sockets hand it to readLineAsync() instead
+			if (::lseek(this->file.descriptor(), 0, SEEK_CUR) >= 0)
+				this->file.seek(0, SEEK_CUR);
+			else
+			{
+				readBufferCapacity = std::max(buffered, File::DefaultReadBufferSize);
+				readBuffer = std::make_unique<char[]>(readBufferCapacity);
+				readEnd = *this->file.tryRead(readBuffer.get(), buffered);
+			}
+		}
+	}
+
+	void AsyncFile::read(void *buffer, size_t bytes, off_t offset, IoEngine::Callback callback)
+	{
+		engine.read(descriptor(), buffer, bytes, offset, std::move(callback));
+	}
+
+	void AsyncFile::write(const void *buffer, size_t bytes, off_t offset, IoEngine::Callback callback)
+	{
+		engine.write(descriptor(), buffer, bytes, offset, std::move(callback));
+	}
+
+	void AsyncFile::fsync(bool dataOnly, IoEngine::Callback callback)
+	{
+		engine.fsync(descriptor(), dataOnly, std::move(callback));
+	}
+
+	void AsyncFile::close(IoEngine::Callback callback)
+	{
+		engine.close(file.release(), std::move(callback));
+	}
+
+	std::future<ssize_t> AsyncFile::read(void *buffer, size_t bytes, off_t offset)
+	{
+		auto [future, callback] = promised();
+		read(buffer, bytes, offset, std::move(callback));
+		return std::move(future);
+	}
+
+	std::future<ssize_t> AsyncFile::write(const void *buffer, size_t bytes, off_t offset)
+	{
+		auto [future, callback] = promised();
+		write(buffer, bytes, offset, std::move(callback));
+		return std::move(future);
+	}
+
+	std::future<ssize_t> AsyncFile::fsync(bool dataOnly)
+	{
+		auto [future, callback] = promised();
+		fsync(dataOnly, std::move(callback));
+		return std::move(future);
+	}
+
+	std::future<ssize_t> AsyncFile::close()
+	{
+		auto [future, callback] = promised();
+		close(std::move(callback));
+		return std::move(future);
+	}
+
+	Task<ssize_t> AsyncFile::readAsync(void *buffer, size_t bytes, off_t offset)
+	{
+		Completion completion{[=, this](IoEngine::Callback callback)
+							  { read(buffer, bytes, offset, std::move(callback)); }};
+		co_return co_await completion;
+	}
+
+	Task<ssize_t> AsyncFile::writeAsync(const void *buffer, size_t bytes, off_t offset)
+	{
+		Completion completion{[=, this](IoEngine::Callback callback)
+							  { write(buffer, bytes, offset, std::move(callback)); }};
+		co_return co_await completion;
+	}
+
+	Task<ssize_t> AsyncFile::fsyncAsync(bool dataOnly)
+	{
+		Completion completion{[=, this](IoEngine::Callback callback)
+							  { fsync(dataOnly, std::move(callback)); }};
+		co_return co_await completion;
+	}
+
+	Task<std::optional<std::string>> AsyncFile::readLineAsync()
+	{
+		// Same scan as File::nextLine(), bytes before this have already been searched for a delimiter
+		size_t scanned = readBegin;
+		while (true)
+		{
+			const char *buffer = readBuffer.get();
+			size_t found = readEnd > scanned ? delimiter.find(buffer, readEnd, scanned, scanState) : DelimiterScanner::npos;
+			if (found != DelimiterScanner::npos)
+			{
+				std::string line(buffer + readBegin, found - readBegin);
+				readBegin = found + delimiter.size();
+				co_return line;
+			}
+
+			// A delimiter may straddle the end of what has been read so far
+			const size_t available = readEnd - readBegin;
+			scanned = available - std::min(delimiter.size() - 1, available);
+
+			// Same compact-or-grow policy as File::fillReadBuffer()
+			scanState.reset();
+			if (!available)
+				readBegin = readEnd = 0;
+			else if (readBegin)
+			{
+				std::memmove(readBuffer.get(), buffer + readBegin, available);
+				readBegin = 0;
+				readEnd = available;
+			}
+			if (readEnd == readBufferCapacity)
+			{
+				size_t grown = readBufferCapacity ? readBufferCapacity * 2 : File::DefaultReadBufferSize;
+				auto grownBuffer = std::make_unique<char[]>(grown);
+				if (readEnd)
+					std::memcpy(grownBuffer.get(), readBuffer.get(), readEnd);
+				readBuffer = std::move(grownBuffer);
+				readBufferCapacity = grown;
+			}
+
+			ssize_t got = co_await readAsync(readBuffer.get() + readEnd, readBufferCapacity - readEnd);
+			if (got == -EINTR)
+				continue;
+			throwIfFailed(got, "read");
+			if (!got)
+				break;
+			readEnd += got;
+		}
+
+		if (readBegin == readEnd)
+			co_return std::nullopt;
+		std::string last(readBuffer.get() + readBegin, readEnd - readBegin);
+		readBegin = readEnd;
+		co_return last;
+	}
+
+	Task<void> AsyncFile::writeAsync(std::string data)
+	{
+		size_t written = 0;
+		while (written < data.size())
+		{
+			ssize_t result = co_await writeAsync(data.data() + written, data.size() - written);
+			if (result == -EINTR)
+				continue;
+			throwIfFailed(result, "write");
+			written += result;
+		}
+	}
+} // namespace Gerk
@@ -0,0 +1,67 @@
+#ifndef INCLUDE_GERK_ASYNC_FILE
+#define INCLUDE_GERK_ASYNC_FILE
+
+#include "delimiterScanner.h"
+#include "file.h"
+#include "ioEngine.h"
+#include "task.h"
+
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace Gerk
+{
+	// A File whose reads, writes, fsync and close go through an IoEngine instead of blocking the caller
+	//
+	// The futures only become ready while some thread is running the engine's complete(), don't wait on one
+	// from the thread that drives the engine without completing in between
+	class AsyncFile
+	{
+		IoEngine &engine;
+		File file;
+
+		// Read-ahead for readLineAsync(), separate from the synchronous File buffer
+		std::unique_ptr<char[]> readBuffer;
+		size_t readBufferCapacity = 0;
+		size_t readBegin = 0;
+		size_t readEnd = 0;
+		// The File's delimiter as it was when wrapped, its State starts over since the read-ahead moved into readBuffer
+		DelimiterScanner delimiter;
+		DelimiterScanner::State scanState;
+
+	public:
+		// Picks up where file left off, what it had read ahead is either given back or kept for readLineAsync()
+		AsyncFile(IoEngine &engine, File &&file);
+
+		File &synchronous() { return file; }
+		IoEngine::Descriptor descriptor() const { return file.descriptor(); }
+
+		// offset is an absolute position, or -1 to use and advance the file offset
+		// buffer must stay alive until the request completes
+		void read(void *buffer, size_t bytes, off_t offset, IoEngine::Callback callback);
+		void write(const void *buffer, size_t bytes, off_t offset, IoEngine::Callback callback);
+		void fsync(bool dataOnly, IoEngine::Callback callback);
+		// Gives the descriptor to the engine to close, this File is closed once it is queued
+		void close(IoEngine::Callback callback);
+
+		// The future holds the byte count or -errno
+		std::future<ssize_t> read(void *buffer, size_t bytes, off_t offset = -1);
+		std::future<ssize_t> write(const void *buffer, size_t bytes, off_t offset = -1);
+		std::future<ssize_t> fsync(bool dataOnly = false);
+		std::future<ssize_t> close();
+
+		// Awaitable versions, the coroutine resumes on the thread running the engine's complete(), see EventLoop
+		Task<ssize_t> readAsync(void *buffer, size_t bytes, off_t offset = -1);
+		Task<ssize_t> writeAsync(const void *buffer, size_t bytes, off_t offset = -1);
+		Task<ssize_t> fsyncAsync(bool dataOnly = false);
+
+		// co_await counterparts of File::readLine() and File::write(), failures are thrown as std::system_error
+		// Lines end at the delimiter the File had when it was wrapped, later setDelimiter() calls on synchronous() don't change it
+		Task<std::optional<std::string>> readLineAsync();
+		Task<void> writeAsync(std::string data);
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_ASYNC_FILE
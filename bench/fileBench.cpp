@@ -0,0 +1,163 @@
+#include "file.h"
+#include "mappedFile.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+	using Gerk::File;
+
+	constexpr size_t InputBytes = 16 << 20;
+
+	std::string scratchPath(const std::string &name)
+	{
+		return (std::filesystem::temp_directory_path() / ("gerkfile_bench_" + std::to_string(::getpid()) + "_" + name)).string();
+	}
+
+	// InputBytes of lines lineLength long including the newline, written once per length and left for the other runs
+	std::string linesFile(size_t lineLength)
+	{
+		std::string path = scratchPath("lines_" + std::to_string(lineLength));
+		if (std::filesystem::exists(path))
+			return path;
+
+		std::string line(lineLength - 1, 'x');
+		line += '\n';
+		File file(path, File::Access::WriteOnly, File::OpenMode::Create | File::OpenMode::Truncate, (File::Permissions)0600);
+		file.setWriteBufferSize(1 << 20);
+		for (size_t written = 0; written < InputBytes; written += line.size())
+			file.write(line);
+		return path;
+	}
+
+	void removeScratch(const benchmark::State &)
+	{
+		for (const auto &entry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path()))
+		{
+			if (entry.path().filename().string().starts_with("gerkfile_bench_" + std::to_string(::getpid()) + "_"))
+				std::filesystem::remove(entry.path());
+		}
+	}
+
+	void lineLengths(benchmark::internal::Benchmark *bench)
+	{
+		for (int length : {16, 128, 1024, 16384})
+			bench->Arg(length);
+	}
+
+	void BM_ReadLineView(benchmark::State &state)
+	{
+		File file(linesFile(state.range(0)), File::Access::ReadOnly);
+		for (auto _ : state)
+		{
+			file.seek(0);
+			size_t lines = 0;
+			for (std::string_view line : file.lines())
+			{
+				benchmark::DoNotOptimize(line.data());
+				lines++;
+			}
+			benchmark::DoNotOptimize(lines);
+		}
+		state.SetBytesProcessed(state.iterations() * InputBytes);
+	}
+	BENCHMARK(BM_ReadLineView)->Apply(lineLengths)->Teardown(removeScratch);
+
+	void BM_ReadLine(benchmark::State &state)
+	{
+		File file(linesFile(state.range(0)), File::Access::ReadOnly);
+		for (auto _ : state)
+		{
+			file.seek(0);
+			while (auto line = file.readLine())
+				benchmark::DoNotOptimize(line->data());
+		}
+		state.SetBytesProcessed(state.iterations() * InputBytes);
+	}
+	BENCHMARK(BM_ReadLine)->Apply(lineLengths)->Teardown(removeScratch);
+
+	void BM_MappedLines(benchmark::State &state)
+	{
+		File file(linesFile(state.range(0)), File::Access::ReadOnly);
+		Gerk::MappedFile mapped(file, {.advice = Gerk::MappedFile::Advice::Sequential});
+		for (auto _ : state)
+		{
+			mapped.rewind();
+			for (std::string_view line : mapped.lines())
+				benchmark::DoNotOptimize(line.data());
+		}
+		state.SetBytesProcessed(state.iterations() * InputBytes);
+	}
+	BENCHMARK(BM_MappedLines)->Apply(lineLengths)->Teardown(removeScratch);
+
+	// Arguments are the write size and the write buffer size, 0 for unbuffered
+	void BM_Write(benchmark::State &state)
+	{
+		const size_t bytes = state.range(0);
+		std::string data(bytes, 'x');
+		File file(scratchPath("write"), File::Access::WriteOnly, File::OpenMode::Create | File::OpenMode::Truncate, (File::Permissions)0600);
+		file.setWriteBufferSize(state.range(1));
+
+		size_t offset = 0;
+		for (auto _ : state)
+		{
+			file.write(data.data(), bytes);
+			// Wrap around so the page cache footprint stays bounded
+			offset += bytes;
+			if (offset >= (64 << 20))
+			{
+				file.seek(0);
+				offset = 0;
+			}
+		}
+		file.flush();
+		state.SetBytesProcessed(state.iterations() * bytes);
+	}
+	BENCHMARK(BM_Write)->ArgsProduct({{16, 256, 4096, 1 << 20}, {0, 64 << 10}})->Teardown(removeScratch);
+
+	// One File shared by every thread, each write taken under lock()
+	std::unique_ptr<File> shared;
+
+	void openShared(const benchmark::State &state)
+	{
+		shared = std::make_unique<File>(scratchPath("contended"), File::Access::WriteOnly, File::OpenMode::Create | File::OpenMode::Truncate | File::OpenMode::Append, (File::Permissions)0600);
+		shared->setWriteBufferSize(state.range(0));
+	}
+
+	void closeShared(const benchmark::State &state)
+	{
+		shared.reset();
+		removeScratch(state);
+	}
+
+	void BM_ContendedWrite(benchmark::State &state)
+	{
+		std::string record(64, 'x');
+		record.back() = '\n';
+		for (auto _ : state)
+		{
+			std::lock_guard<File> guard(*shared);
+			shared->write(record);
+		}
+		state.SetBytesProcessed(state.iterations() * record.size());
+	}
+	BENCHMARK(BM_ContendedWrite)->Arg(0)->Arg(64 << 10)->ThreadRange(1, 8)->UseRealTime()->Setup(openShared)->Teardown(closeShared);
+
+	void BM_Lock(benchmark::State &state)
+	{
+		for (auto _ : state)
+		{
+			shared->lock();
+			shared->unlock();
+		}
+	}
+	BENCHMARK(BM_Lock)->Arg(0)->ThreadRange(1, 8)->UseRealTime()->Setup(openShared)->Teardown(closeShared);
+} // namespace
+
+BENCHMARK_MAIN();
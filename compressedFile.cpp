@@ -0,0 +1,501 @@
+#include "compressedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+#include <utility>
+#include <sys/stat.h>
+
+#ifdef GERK_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef GERK_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		[[noreturn]] void throwCorrupt(const std::string &what)
+		{
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), what);
+		}
+
+		[[noreturn]] void throwUnsupported(Codec codec)
+		{
+			throw std::system_error(std::make_error_code(std::errc::not_supported), codec == Codec::Zstd ? "built without zstd" : "built without lz4");
+		}
+
+		// See zstd's contrib/seekable_format/zstd_seekable_compression_format.md
+		constexpr uint32_t SkippableMagic = 0x184D2A5E;
+		constexpr uint32_t SeekableMagic = 0x8F92EAB1;
+		constexpr size_t FooterSize = 9;
+		constexpr uint8_t ChecksumFlag = 0x80;
+
+		constexpr uint32_t ZstdMagic = 0xFD2FB528;
+		constexpr uint32_t Lz4Magic = 0x184D2204;
+
+		// Frame sizes in the seek table are 32 bits
+		constexpr size_t MaxBlockSize = 1 << 30;
+
+		void put32(std::string &out, uint32_t value)
+		{
+			char bytes[4] = {(char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24)};
+			out.append(bytes, 4);
+		}
+
+		uint32_t get32(const char *data)
+		{
+			const unsigned char *bytes = (const unsigned char *)data;
+			return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+		}
+
+		void compressBlock(Codec codec, void *context, int level, const std::string &in, std::string &out)
+		{
+			if (codec == Codec::Zstd)
+			{
+#ifdef GERK_HAVE_ZSTD
+				out.resize(ZSTD_compressBound(in.size()));
+				size_t result = ZSTD_compressCCtx((ZSTD_CCtx *)context, out.data(), out.size(), in.data(), in.size(), level);
+				if (ZSTD_isError(result))
+					throwCorrupt(std::string("zstd: ") + ZSTD_getErrorName(result));
+				out.resize(result);
+				return;
+#endif
+			}
+			else
+			{
+#ifdef GERK_HAVE_LZ4
+				LZ4F_preferences_t preferences = {};
+				preferences.compressionLevel = level;
+				preferences.frameInfo.contentSize = in.size();
+				out.resize(LZ4F_compressFrameBound(in.size(), &preferences));
+				size_t result = LZ4F_compressFrame(out.data(), out.size(), in.data(), in.size(), &preferences);
+				if (LZ4F_isError(result))
+					throwCorrupt(std::string("lz4: ") + LZ4F_getErrorName(result));
+				out.resize(result);
+				return;
+#endif
+			}
+			(void)context, (void)level, (void)in, (void)out;
+			throwUnsupported(codec);
+		}
+	} // namespace
+
+	CompressedWriter::CompressedWriter(File &file, Options options)
+		: file(file), options(options)
+	{
+#ifndef GERK_HAVE_ZSTD
+		if (options.codec == Codec::Zstd)
+			throwUnsupported(options.codec);
+#endif
+#ifndef GERK_HAVE_LZ4
+		if (options.codec == Codec::Lz4)
+			throwUnsupported(options.codec);
+#endif
+		if (!this->options.blockSize || this->options.blockSize > MaxBlockSize)
+			this->options.blockSize = this->options.blockSize ? MaxBlockSize : Options().blockSize;
+		if (!this->options.queueDepth)
+			this->options.queueDepth = 1;
+		pending.reserve(this->options.blockSize);
+		compressor = std::thread(&CompressedWriter::run, this);
+	}
+
+	CompressedWriter::~CompressedWriter()
+	{
+		try
+		{
+			finish();
+		}
+		catch (const std::exception &)
+		{
+			// Nowhere to report it, the partly written file has no seek table
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		work.notify_one();
+		compressor.join();
+	}
+
+	void CompressedWriter::run()
+	{
+		void *context = nullptr;
+#ifdef GERK_HAVE_ZSTD
+		if (options.codec == Codec::Zstd)
+			context = ZSTD_createCCtx();
+#endif
+
+		std::string out;
+		std::unique_lock<std::mutex> guard(mutex);
+		while (true)
+		{
+			work.wait(guard, [&]
+					  { return !queued.empty() || stopping; });
+			if (queued.empty())
+				break;
+
+			std::string block = std::move(queued.front());
+			queued.pop_front();
+			compressing = true;
+			bool failed = (bool)failure;
+			guard.unlock();
+
+			// After a failure blocks are only drained, so writers waiting for room wake up and see it
+			std::exception_ptr error;
+			if (!failed)
+			{
+				try
+				{
+					compressBlock(options.codec, context, options.level, block, out);
+					file.write(out.data(), out.size());
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+			}
+
+			guard.lock();
+			compressing = false;
+			if (error)
+				failure = error;
+			else if (!failed)
+			{
+				frames.push_back({(uint32_t)out.size(), (uint32_t)block.size()});
+				bytesOut += out.size();
+			}
+			room.notify_all();
+		}
+
+#ifdef GERK_HAVE_ZSTD
+		if (context)
+			ZSTD_freeCCtx((ZSTD_CCtx *)context);
+#endif
+	}
+
+	void CompressedWriter::rethrow()
+	{
+		if (failure)
+			std::rethrow_exception(failure);
+	}
+
+	void CompressedWriter::submit()
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		room.wait(guard, [&]
+				  { return queued.size() < options.queueDepth || failure; });
+		rethrow();
+		queued.push_back(std::move(pending));
+		guard.unlock();
+		work.notify_one();
+
+		pending = std::string();
+		pending.reserve(options.blockSize);
+	}
+
+	CompressedWriter &CompressedWriter::write(std::string_view data)
+	{
+		if (finished)
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "CompressedWriter: write after finish");
+
+		bytesIn += data.size();
+		while (!data.empty())
+		{
+			size_t take = std::min(options.blockSize - pending.size(), data.size());
+			pending.append(data.data(), take);
+			data.remove_prefix(take);
+			if (pending.size() == options.blockSize)
+				submit();
+		}
+		return *this;
+	}
+
+	CompressedWriter &CompressedWriter::flush()
+	{
+		if (!pending.empty())
+			submit();
+
+		std::unique_lock<std::mutex> guard(mutex);
+		room.wait(guard, [&]
+				  { return (queued.empty() && !compressing) || failure; });
+		rethrow();
+		guard.unlock();
+
+		file.flush();
+		return *this;
+	}
+
+	void CompressedWriter::finish()
+	{
+		if (finished)
+			return;
+		flush();
+
+		std::string table;
+		uint32_t frameSize = (uint32_t)(frames.size() * 8 + FooterSize);
+		table.reserve(8 + frameSize);
+		put32(table, SkippableMagic);
+		put32(table, frameSize);
+		for (const Frame &frame : frames)
+		{
+			put32(table, frame.compressed);
+			put32(table, frame.decompressed);
+		}
+		put32(table, (uint32_t)frames.size());
+		table.push_back(0);
+		put32(table, SeekableMagic);
+
+		file.write(table.data(), table.size());
+		file.flush();
+		finished = true;
+	}
+
+	uint64_t CompressedWriter::compressed()
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		return bytesOut;
+	}
+
+	CompressedReader::CompressedReader(File &file)
+		: file(file), codec(Codec::Zstd)
+	{
+		struct stat info;
+		if (::fstat(file.descriptor(), &info) < 0)
+			throwErrno("fstat");
+		const uint64_t fileSize = info.st_size;
+
+		char footer[FooterSize];
+		if (fileSize < 8 + FooterSize || file.readAt(fileSize - FooterSize, footer, FooterSize) != FooterSize || get32(footer + 5) != SeekableMagic)
+			throwCorrupt("CompressedReader: no seek table");
+
+		const uint64_t count = get32(footer);
+		const uint8_t descriptor = (uint8_t)footer[4];
+		const size_t entrySize = (descriptor & ChecksumFlag) ? 12 : 8;
+		const uint64_t tableSize = count * entrySize + FooterSize;
+		if (tableSize + 8 > fileSize)
+			throwCorrupt("CompressedReader: seek table larger than the file");
+
+		std::string table(tableSize + 8, '\0');
+		if (file.readAt(fileSize - table.size(), table.data(), table.size()) != table.size() || get32(table.data()) != SkippableMagic || get32(table.data() + 4) != tableSize)
+			throwCorrupt("CompressedReader: malformed seek table");
+
+		frames.reserve(count);
+		uint64_t compressedOffset = 0;
+		for (uint64_t i = 0; i < count; i++)
+		{
+			const char *entry = table.data() + 8 + i * entrySize;
+			Frame frame{compressedOffset, length, get32(entry), get32(entry + 4)};
+			frames.push_back(frame);
+			compressedOffset += frame.compressed;
+			length += frame.decompressed;
+		}
+		if (compressedOffset != fileSize - table.size())
+			throwCorrupt("CompressedReader: seek table doesn't match the frames");
+
+		if (count)
+		{
+			char magic[4];
+			if (file.readAt(0, magic, 4) != 4)
+				throwCorrupt("CompressedReader: truncated frame");
+			if (get32(magic) == ZstdMagic)
+				codec = Codec::Zstd;
+			else if (get32(magic) == Lz4Magic)
+				codec = Codec::Lz4;
+			else
+				throwCorrupt("CompressedReader: frames are neither zstd nor lz4");
+		}
+
+		if (codec == Codec::Zstd)
+		{
+#ifdef GERK_HAVE_ZSTD
+			context = ZSTD_createDCtx();
+#else
+			if (count)
+				throwUnsupported(codec);
+#endif
+		}
+		else
+		{
+#ifdef GERK_HAVE_LZ4
+			LZ4F_dctx *created;
+			if (LZ4F_isError(LZ4F_createDecompressionContext(&created, LZ4F_VERSION)))
+				throw std::bad_alloc();
+			context = created;
+#else
+			throwUnsupported(codec);
+#endif
+		}
+	}
+
+	CompressedReader::CompressedReader(CompressedReader &&other)
+		: file(other.file), codec(other.codec), frames(std::move(other.frames)), length(other.length), context(std::exchange(other.context, nullptr)),
+		  buffer(std::move(other.buffer)), begin(other.begin), end(other.end), nextFrame(other.nextFrame),
+		  delimiter(other.delimiter), scanState(other.scanState)
+	{
+		other.begin = other.end = 0;
+	}
+
+	CompressedReader::~CompressedReader()
+	{
+		if (!context)
+			return;
+#ifdef GERK_HAVE_ZSTD
+		if (codec == Codec::Zstd)
+			ZSTD_freeDCtx((ZSTD_DCtx *)context);
+#endif
+#ifdef GERK_HAVE_LZ4
+		if (codec == Codec::Lz4)
+			LZ4F_freeDecompressionContext((LZ4F_dctx *)context);
+#endif
+	}
+
+	void CompressedReader::decompress(const Frame &frame, char *out)
+	{
+		compressedScratch.resize(frame.compressed);
+		if (file.readAt(frame.compressedOffset, compressedScratch.data(), frame.compressed) != frame.compressed)
+			throwCorrupt("CompressedReader: truncated frame");
+
+#ifdef GERK_HAVE_ZSTD
+		if (codec == Codec::Zstd)
+		{
+			size_t result = ZSTD_decompressDCtx((ZSTD_DCtx *)context, out, frame.decompressed, compressedScratch.data(), frame.compressed);
+			if (ZSTD_isError(result))
+				throwCorrupt(std::string("zstd: ") + ZSTD_getErrorName(result));
+			if (result != frame.decompressed)
+				throwCorrupt("CompressedReader: frame size doesn't match the seek table");
+			return;
+		}
+#endif
+#ifdef GERK_HAVE_LZ4
+		if (codec == Codec::Lz4)
+		{
+			LZ4F_dctx *lz4 = (LZ4F_dctx *)context;
+			size_t produced = 0;
+			size_t consumed = 0;
+			size_t result;
+			do
+			{
+				size_t outBytes = frame.decompressed - produced;
+				size_t inBytes = frame.compressed - consumed;
+				result = LZ4F_decompress(lz4, out + produced, &outBytes, compressedScratch.data() + consumed, &inBytes, nullptr);
+				if (LZ4F_isError(result))
+				{
+					LZ4F_resetDecompressionContext(lz4);
+					throwCorrupt(std::string("lz4: ") + LZ4F_getErrorName(result));
+				}
+				produced += outBytes;
+				consumed += inBytes;
+				if (!outBytes && !inBytes && result)
+				{
+					LZ4F_resetDecompressionContext(lz4);
+					throwCorrupt("CompressedReader: frame size doesn't match the seek table");
+				}
+			} while (result);
+			if (produced != frame.decompressed)
+				throwCorrupt("CompressedReader: frame size doesn't match the seek table");
+			return;
+		}
+#endif
+		(void)out;
+		throwUnsupported(codec);
+	}
+
+	bool CompressedReader::fill()
+	{
+		if (nextFrame == frames.size())
+			return false;
+
+		// The bytes move either way
+		scanState.reset();
+		const Frame &frame = frames[nextFrame];
+		if (begin)
+		{
+			std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+			end -= begin;
+			begin = 0;
+		}
+		if (buffer.size() < end + frame.decompressed)
+			buffer.resize(end + frame.decompressed);
+
+		decompress(frame, buffer.data() + end);
+		end += frame.decompressed;
+		nextFrame++;
+		return true;
+	}
+
+	std::optional<std::string_view> CompressedReader::readLineView()
+	{
+		size_t from = begin;
+		while (true)
+		{
+			size_t found = delimiter.find(buffer.data(), end, from, scanState);
+			if (found != DelimiterScanner::npos)
+			{
+				std::string_view line(buffer.data() + begin, found - begin);
+				begin = found + delimiter.size();
+				return line;
+			}
+
+			// A delimiter may straddle the end, so rescan its first bytes once more has arrived
+			size_t scanned = end - begin;
+			if (!fill())
+			{
+				if (begin == end)
+					return std::nullopt;
+				std::string_view line(buffer.data() + begin, end - begin);
+				begin = end;
+				return line;
+			}
+			from = begin + (scanned >= delimiter.size() ? scanned - delimiter.size() + 1 : 0);
+		}
+	}
+
+	std::optional<std::string> CompressedReader::readLine()
+	{
+		if (auto line = readLineView())
+			return std::string(*line);
+		return std::nullopt;
+	}
+
+	size_t CompressedReader::read(char *out, size_t bytes)
+	{
+		size_t total = 0;
+		while (total < bytes)
+		{
+			if (begin == end && !fill())
+				break;
+			size_t take = std::min(bytes - total, end - begin);
+			std::memcpy(out + total, buffer.data() + begin, take);
+			begin += take;
+			total += take;
+		}
+		return total;
+	}
+
+	void CompressedReader::seek(uint64_t offset)
+	{
+		begin = end = 0;
+		scanState.reset();
+		if (offset >= length)
+		{
+			nextFrame = frames.size();
+			return;
+		}
+
+		auto after = std::upper_bound(frames.begin(), frames.end(), offset, [](uint64_t wanted, const Frame &frame)
+									  { return wanted < frame.decompressedOffset; });
+		nextFrame = (after - frames.begin()) - 1;
+		uint64_t start = frames[nextFrame].decompressedOffset;
+		fill();
+		begin = offset - start;
+	}
+} // namespace Gerk
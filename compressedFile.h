@@ -0,0 +1,168 @@
+#ifndef INCLUDE_GERK_COMPRESSED_FILE
+#define INCLUDE_GERK_COMPRESSED_FILE
+
+#include "file.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Gerk
+{
+	// Compressed files are a run of independently compressed frames followed by a seek table, in the zstd seekable format
+	// (a skippable frame listing each frame's compressed and decompressed size), so a reader can start at any frame
+	// The frames are plain zstd or LZ4 frames, any decoder of either reads the data back, ignoring the table
+	enum class Codec
+	{
+		Zstd,
+		Lz4,
+	};
+
+	// Compresses everything written to it into a File, a block at a time on a background thread
+	// Only available when the library is built with zstd or lz4, using a codec it wasn't built with throws std::errc::not_supported
+	class CompressedWriter
+	{
+	public:
+		struct Options
+		{
+			Codec codec = Codec::Zstd;
+			// zstd 1 to 19 (or negative for faster), LZ4 0 to 12, 0 is each codec's default
+			int level = 0;
+			// Decompressed bytes per frame, larger compresses better, smaller makes seeking cheaper
+			size_t blockSize = 1 << 20;
+			// Blocks waiting to be compressed before write() blocks
+			size_t queueDepth = 4;
+		};
+
+	private:
+		struct Frame
+		{
+			uint32_t compressed;
+			uint32_t decompressed;
+		};
+
+		File &file;
+		Options options;
+
+		// Block being filled by write()
+		std::string pending;
+
+		std::mutex mutex;
+		// Wakes the compressor
+		std::condition_variable work;
+		// Wakes writers waiting for room in the queue or for it to drain
+		std::condition_variable room;
+		std::deque<std::string> queued;
+		// Taken off the queue but not yet written
+		bool compressing = false;
+		bool stopping = false;
+		// The first error of the compressor, rethrown from every call after it
+		std::exception_ptr failure;
+		std::vector<Frame> frames;
+		// bytesIn is only touched by the writing thread, bytesOut under the mutex
+		uint64_t bytesIn = 0;
+		uint64_t bytesOut = 0;
+		bool finished = false;
+
+		std::thread compressor;
+
+		void run();
+		// Queues pending as the next block
+		void submit();
+		void rethrow();
+
+	public:
+		// file should be empty, the frames are written at its file offset and the seek table after them
+		CompressedWriter(File &file, Options options);
+		explicit CompressedWriter(File &file) : CompressedWriter(file, Options()) {}
+		// finish() unless it was already called, errors are swallowed since there is nowhere to report them
+		~CompressedWriter();
+
+		CompressedWriter(const CompressedWriter &) = delete;
+		CompressedWriter &operator=(const CompressedWriter &) = delete;
+
+		CompressedWriter &write(std::string_view data);
+		CompressedWriter &write(const char *data, size_t bytes) { return write(std::string_view(data, bytes)); }
+
+		// Compresses the partly filled block and waits until every frame so far is written to the File and flushed
+		// Ends a frame early, flushing often costs compression ratio
+		CompressedWriter &flush();
+		// flush() then the seek table, nothing can be written afterwards
+		void finish();
+
+		// Bytes given to write() so far, and the compressed size of the frames already written to the File
+		uint64_t written() const { return bytesIn; }
+		uint64_t compressed();
+	};
+
+	// Reads a file made by CompressedWriter, or any zstd seekable format file, back through the same line API as File
+	class CompressedReader
+	{
+		struct Frame
+		{
+			uint64_t compressedOffset;
+			uint64_t decompressedOffset;
+			uint32_t compressed;
+			uint32_t decompressed;
+		};
+
+		File &file;
+		Codec codec;
+		std::vector<Frame> frames;
+		uint64_t length = 0;
+
+		// Decompression context of the codec, freed by the destructor
+		void *context = nullptr;
+
+		// Decompressed bytes, [begin, end) not yet consumed
+		std::string buffer;
+		size_t begin = 0;
+		size_t end = 0;
+		// Next frame to decompress into the buffer
+		size_t nextFrame = 0;
+		std::string compressedScratch;
+
+		DelimiterScanner delimiter;
+		DelimiterScanner::State scanState;
+
+		// Appends the next frame to the buffer, false once they are all read
+		bool fill();
+		void decompress(const Frame &frame, char *out);
+
+	public:
+		// Reads the seek table from the end of the file, std::errc::illegal_byte_sequence if there isn't one
+		explicit CompressedReader(File &file);
+		CompressedReader(CompressedReader &&other);
+		~CompressedReader();
+
+		// Decompressed size of the whole file
+		uint64_t size() const { return length; }
+		Codec format() const { return codec; }
+
+		// Same as File's, the last line doesn't need a delimiter
+		std::optional<std::string_view> readLineView();
+		std::optional<std::string> readLine();
+		void setDelimiter(std::string_view delimiter)
+		{
+			this->delimiter = DelimiterScanner(delimiter);
+			scanState.reset();
+		}
+
+		using Lines = LineRange<CompressedReader>;
+		Lines lines() { return Lines(*this); }
+
+		// Up to bytes of decompressed data, 0 at the end
+		size_t read(char *out, size_t bytes);
+		// Moves to a decompressed offset, only the frame holding it is decompressed
+		void seek(uint64_t offset);
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_COMPRESSED_FILE
@@ -0,0 +1,169 @@
+#include "delimiterScanner.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GERK_SCANNER_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define GERK_SCANNER_NEON 1
+#endif
+
+namespace Gerk
+{
+	namespace
+	{
+		// Bit i is set when block[i] == byte, block must have 64 readable bytes
+		using BlockKernel = uint64_t (*)(const char *block, char byte);
+
+		[[maybe_unused]] uint64_t scalarBlock(const char *block, char byte)
+		{
+			uint64_t mask = 0;
+			for (unsigned i = 0; i < 64; i++)
+				mask |= (uint64_t)(block[i] == byte) << i;
+			return mask;
+		}
+
+#if GERK_SCANNER_X86
+		uint64_t sse2Block(const char *block, char byte)
+		{
+			const __m128i needle = _mm_set1_epi8(byte);
+			uint64_t mask = 0;
+			for (unsigned i = 0; i < 4; i++)
+			{
+				__m128i bytes = _mm_loadu_si128((const __m128i *)(block + i * 16));
+				mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle)) << (i * 16);
+			}
+			return mask;
+		}
+
+		__attribute__((target("avx2"))) uint64_t avx2Block(const char *block, char byte)
+		{
+			const __m256i needle = _mm256_set1_epi8(byte);
+			__m256i low = _mm256_loadu_si256((const __m256i *)block);
+			__m256i high = _mm256_loadu_si256((const __m256i *)(block + 32));
+			uint32_t lowMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle));
+			uint32_t highMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle));
+			return (uint64_t)highMask << 32 | lowMask;
+		}
+
+		__attribute__((target("avx512f,avx512bw"))) uint64_t avx512Block(const char *block, char byte)
+		{
+			return _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(block), _mm512_set1_epi8(byte));
+		}
+#endif
+
+#if GERK_SCANNER_NEON
+		uint64_t neonBlock(const char *block, char byte)
+		{
+			const uint8x16_t needle = vdupq_n_u8((uint8_t)byte);
+			const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+			uint8x16_t m0 = vandq_u8(vceqq_u8(vld1q_u8((const uint8_t *)block), needle), bits);
+			uint8x16_t m1 = vandq_u8(vceqq_u8(vld1q_u8((const uint8_t *)block + 16), needle), bits);
+			uint8x16_t m2 = vandq_u8(vceqq_u8(vld1q_u8((const uint8_t *)block + 32), needle), bits);
+			uint8x16_t m3 = vandq_u8(vceqq_u8(vld1q_u8((const uint8_t *)block + 48), needle), bits);
+			// Three rounds of pairwise adds fold each group of 8 lanes into one byte of the mask
+			uint8x16_t sum = vpaddq_u8(vpaddq_u8(m0, m1), vpaddq_u8(m2, m3));
+			sum = vpaddq_u8(sum, sum);
+			return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+		}
+#endif
+
+		struct Kernel
+		{
+			BlockKernel block;
+			const char *name;
+		};
+
+		Kernel pick()
+		{
+#if GERK_SCANNER_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512bw"))
+				return {avx512Block, "avx512"};
+			if (__builtin_cpu_supports("avx2"))
+				return {avx2Block, "avx2"};
+			return {sse2Block, "sse2"};
+#elif GERK_SCANNER_NEON
+			return {neonBlock, "neon"};
+#else
+			return {scalarBlock, "scalar"};
+#endif
+		}
+
+		// Picked on first use rather than during static initialisation, so Files opened by other static constructors can scan
+		const Kernel &kernel()
+		{
+			static const Kernel picked = pick();
+			return picked;
+		}
+	} // namespace
+
+	DelimiterScanner::DelimiterScanner(std::string_view delimiter)
+		: delimiter(delimiter)
+	{
+		if (delimiter.empty())
+			throw std::invalid_argument("DelimiterScanner needs a non-empty delimiter");
+	}
+
+	const char *DelimiterScanner::implementation()
+	{
+		return kernel().name;
+	}
+
+	size_t DelimiterScanner::find(const char *data, size_t bytes, size_t from, State &state) const
+	{
+		const BlockKernel block = kernel().block;
+		const char first = delimiter[0];
+		const size_t length = delimiter.size();
+
+		// Longer delimiters are found by their first byte and confirmed here
+		auto confirm = [&](size_t position)
+		{ return length == 1 || (position + length <= bytes && !std::memcmp(data + position + 1, delimiter.data() + 1, length - 1)); };
+
+		size_t start = from;
+		if (state.valid && from >= state.base && from < state.base + 64)
+		{
+			uint64_t mask = state.mask & (~(uint64_t)0 << (from - state.base));
+			while (mask)
+			{
+				size_t position = state.base + __builtin_ctzll(mask);
+				if (confirm(position))
+					return position;
+				mask &= mask - 1;
+			}
+			start = state.base + 64;
+		}
+
+		while (start + 64 <= bytes)
+		{
+			uint64_t mask = block(data + start, first);
+			state.base = start;
+			state.mask = mask;
+			state.valid = true;
+			while (mask)
+			{
+				size_t position = start + __builtin_ctzll(mask);
+				if (confirm(position))
+					return position;
+				mask &= mask - 1;
+			}
+			start += 64;
+		}
+
+		// The tail is shorter than a block and may still grow, so it isn't cached
+		while (start < bytes)
+		{
+			const char *found = (const char *)std::memchr(data + start, first, bytes - start);
+			if (!found)
+				break;
+			size_t position = found - data;
+			if (confirm(position))
+				return position;
+			start = position + 1;
+		}
+		return npos;
+	}
+} // namespace Gerk
@@ -0,0 +1,55 @@
+#ifndef INCLUDE_GERK_DELIMITER_SCANNER
+#define INCLUDE_GERK_DELIMITER_SCANNER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Gerk
+{
+	// Finds delimiters 64 bytes at a time, turning each block into a bitmask of matches with the widest SIMD the CPU has
+	// (AVX-512BW, AVX2, SSE2 or NEON, picked at runtime) and a scalar fallback
+	//
+	// Scanning one block answers every delimiter in it, State keeps that mask so the following finds are a bit scan
+	class DelimiterScanner
+	{
+	public:
+		static constexpr size_t npos = SIZE_MAX;
+
+		// Mask of the last full block scanned, only valid while the bytes it covers stay where they are
+		struct State
+		{
+			size_t base = 0;
+			uint64_t mask = 0;
+			bool valid = false;
+
+			// Call whenever the scanned bytes move or change
+			void reset() { valid = false; }
+		};
+
+	private:
+		std::string delimiter;
+
+	public:
+		// Any non-empty byte sequence, "\n", std::string_view("\0", 1) or "\r\n" for instance
+		explicit DelimiterScanner(std::string_view delimiter = "\n");
+
+		size_t size() const { return delimiter.size(); }
+		std::string_view value() const { return delimiter; }
+
+		// Position of the first complete delimiter at or after from in [data, data + bytes), npos if there is none
+		// A delimiter cut off by the end of the data isn't found, so rescan from at most bytes - size() + 1 once more arrives
+		size_t find(const char *data, size_t bytes, size_t from, State &state) const;
+		size_t find(const char *data, size_t bytes, size_t from = 0) const
+		{
+			State state;
+			return find(data, bytes, from, state);
+		}
+
+		// Name of the block kernel picked for this CPU
+		static const char *implementation();
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_DELIMITER_SCANNER
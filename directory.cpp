@@ -0,0 +1,89 @@
+#include "directory.h"
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+	} // namespace
+
+	namespace detail
+	{
+		CString::CString(std::string_view text)
+		{
+			if (text.size() < sizeof(small))
+			{
+				std::memcpy(small, text.data(), text.size());
+				small[text.size()] = '\0';
+				pointer = small;
+			}
+			else
+			{
+				large.assign(text);
+				pointer = large.c_str();
+			}
+		}
+
+		int openAt(int dirfd, const char *path, int flags, mode_t mode, uint64_t resolve)
+		{
+			int fd;
+			if (resolve)
+			{
+				open_how how = {};
+				how.flags = (uint64_t)flags;
+				// openat2(2) refuses a mode unless the call can create the file
+				how.mode = (flags & (O_CREAT | O_TMPFILE)) ? mode : 0;
+				how.resolve = resolve;
+				do
+					fd = (int)::syscall(SYS_openat2, dirfd, path, &how, sizeof(how));
+				while (fd < 0 && errno == EINTR);
+				return fd;
+			}
+
+			do
+				fd = ::openat(dirfd, path, flags, mode);
+			while (fd < 0 && errno == EINTR);
+			return fd;
+		}
+	} // namespace detail
+
+	Directory::Directory(const char *path)
+		: fd(detail::openAt(AT_FDCWD, path, O_PATH | O_DIRECTORY | O_CLOEXEC, 0, 0))
+	{
+		if (fd < 0)
+			throwErrno("open");
+	}
+
+	Directory::Directory(const Directory &parent, std::string_view name, Resolve resolve)
+		: fd(detail::openAt(parent.fd, detail::CString(name).c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC, 0, (uint64_t)resolve))
+	{
+		if (fd < 0)
+			throwErrno(resolve != Resolve::None ? "openat2" : "openat");
+	}
+
+	Directory::Directory(Directory &&other) : fd(std::exchange(other.fd, -1))
+	{
+	}
+
+	Directory::~Directory()
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	int Directory::release()
+	{
+		return std::exchange(fd, -1);
+	}
+} // namespace Gerk
@@ -0,0 +1,112 @@
+#ifndef INCLUDE_GERK_DIRECTORY
+#define INCLUDE_GERK_DIRECTORY
+
+#include "flags.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <linux/openat2.h>
+
+namespace Gerk
+{
+	namespace detail
+	{
+		// NUL terminated copy of a string_view for the system calls, on the stack unless it's long
+		class CString
+		{
+			char small[256];
+			std::string large;
+			const char *pointer;
+
+		public:
+			explicit CString(std::string_view text);
+			CString(const CString &) = delete;
+			CString &operator=(const CString &) = delete;
+
+			const char *c_str() const { return pointer; }
+		};
+
+		// openat2(2) relative to dirfd (or AT_FDCWD), plain openat(2) when no resolve flags are asked for
+		// Resolve flags can't be honoured without openat2, so a kernel older than 5.6 fails them with ENOSYS rather than ignoring them
+		// Retries EINTR, returns -1 with errno set on failure
+		int openAt(int dirfd, const char *path, int flags, mode_t mode, uint64_t resolve);
+	} // namespace detail
+
+	// O_PATH handle on a directory, for opening the files in it without walking the whole path each time
+	class Directory
+	{
+	public:
+		// How openat2(2) resolves a path relative to the directory
+		enum class Resolve : uint64_t
+		{
+			None = 0,
+
+			/*
+			Disallow traversal of mount points during path resolution (including all bind mounts).
+			Consequently, pathname must either be on the same mount as the directory referred to by dirfd,
+			or on the same mount as the current working directory if dirfd is specified as AT_FDCWD.
+			*/
+			NoCrossMounts = RESOLVE_NO_XDEV,
+
+			/*
+			Disallow all magic-link resolution during path resolution.
+			Magic links are symbolic link-like objects that are most notably found in proc(5);
+			examples include /proc/pid/exe and /proc/pid/fd/N.
+			*/
+			NoMagicLinks = RESOLVE_NO_MAGICLINKS,
+
+			/*
+			Disallow resolution of symbolic links during path resolution.  This option implies
+			RESOLVE_NO_MAGICLINKS.
+			*/
+			NoSymlinks = RESOLVE_NO_SYMLINKS,
+
+			/*
+			Do not permit the path resolution to succeed if any component of the resolution is not
+			a descendant of the directory indicated by dirfd.  This causes absolute symbolic links
+			(and absolute values of pathname) to be rejected.
+			*/
+			Beneath = RESOLVE_BENEATH,
+
+			/*
+			Treat the directory referred to by dirfd as the root directory while resolving pathname.
+			Absolute symbolic links are interpreted relative to dirfd.
+			*/
+			InRoot = RESOLVE_IN_ROOT,
+
+			/*
+			Make the open operation fail unless all path components are already present in the
+			kernel's lookup cache.  If any kind of revalidation or I/O is needed to satisfy the
+			lookup, openat2() fails with the error EAGAIN.
+			*/
+			Cached = RESOLVE_CACHED,
+		};
+
+	private:
+		int fd;
+
+	public:
+		explicit Directory(const char *path);
+		explicit Directory(const std::string &path) : Directory(path.c_str()) {}
+		explicit Directory(std::string_view path) : Directory(detail::CString(path).c_str()) {}
+		// A subdirectory of parent, resolved there
+		Directory(const Directory &parent, std::string_view name, Resolve resolve = Resolve::None);
+
+		Directory(Directory &&other);
+		Directory(const Directory &) = delete;
+		Directory &operator=(const Directory &) = delete;
+		~Directory();
+
+		// The underlying O_PATH descriptor, still owned by this Directory
+		int descriptor() const { return fd; }
+		// Gives up ownership of the descriptor, leaving this Directory closed
+		int release();
+	};
+
+	template <>
+	inline constexpr bool IsFlagSet<Directory::Resolve> = true;
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_DIRECTORY
@@ -0,0 +1,61 @@
+#include "eventLoop.h"
+
+namespace Gerk
+{
+	// Fire and forget coroutine owning a spawned task, frees itself when done
+	struct EventLoop::Detached
+	{
+		struct promise_type
+		{
+			Detached get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	EventLoop::Detached EventLoop::launch(EventLoop &loop, Task<void> task)
+	{
+		try
+		{
+			co_await std::move(task);
+		}
+		catch (...)
+		{
+			if (!loop.failure)
+				loop.failure = std::current_exception();
+		}
+		--loop.active;
+	}
+
+	void EventLoop::spawn(Task<void> task)
+	{
+		++active;
+		ready.push_back(launch(*this, std::move(task)).handle);
+	}
+
+	void EventLoop::run()
+	{
+		while (active)
+		{
+			while (!ready.empty())
+			{
+				auto handle = ready.front();
+				ready.pop_front();
+				handle.resume();
+			}
+
+			// Completions resume their coroutines from inside complete()
+			if (engine.pending())
+				engine.complete(ready.empty());
+			else if (ready.empty())
+				break;
+		}
+
+		if (failure)
+			std::rethrow_exception(std::exchange(failure, nullptr));
+	}
+} // namespace Gerk
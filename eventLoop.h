@@ -0,0 +1,57 @@
+#ifndef INCLUDE_GERK_EVENT_LOOP
+#define INCLUDE_GERK_EVENT_LOOP
+
+#include "ioEngine.h"
+#include "task.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+
+namespace Gerk
+{
+	// Runs coroutines on one thread, resuming them as their IoEngine requests complete
+	//
+	// Nothing here is thread safe, scale out with one loop and one engine per core
+	class EventLoop
+	{
+		IoEngine &engine;
+		std::deque<std::coroutine_handle<>> ready;
+		size_t active = 0;
+		std::exception_ptr failure;
+
+		struct Detached;
+		static Detached launch(EventLoop &loop, Task<void> task);
+
+	public:
+		explicit EventLoop(IoEngine &engine) : engine(engine) {}
+
+		EventLoop(const EventLoop &) = delete;
+		EventLoop &operator=(const EventLoop &) = delete;
+
+		IoEngine &io() { return engine; }
+
+		// Starts the task the next time run() gets to it
+		void spawn(Task<void> task);
+
+		// Runs until every spawned task has finished or nothing is left that could wake the rest
+		// Rethrows the first exception that escaped a spawned task
+		void run();
+
+		// Lets every other ready coroutine run before resuming
+		auto yield()
+		{
+			struct Awaiter
+			{
+				EventLoop &loop;
+				bool await_ready() { return false; }
+				void await_suspend(std::coroutine_handle<> handle) { loop.ready.push_back(handle); }
+				void await_resume() {}
+			};
+			return Awaiter{*this};
+		}
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_EVENT_LOOP
@@ -0,0 +1,1633 @@
+#include "file.h"
+#include "alignedBuffer.h"
+#include "lineIndex.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <vector>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		// OpenMode has no access mode bits, so open read/write where we can and fall back to read only
+		// Returns -1 with errno set on failure
+		int tryOpenPath(int dirfd, const char *path, int flags, mode_t mode, uint64_t resolve = 0)
+		{
+			int access = (flags & (O_PATH | O_DIRECTORY)) ? O_RDONLY : O_RDWR;
+			int fd = detail::openAt(dirfd, path, flags | access, mode, resolve);
+
+			if (fd < 0 && access == O_RDWR && !(flags & (O_CREAT | O_TMPFILE)) && (errno == EACCES || errno == EROFS || errno == EISDIR || errno == ETXTBSY))
+				fd = detail::openAt(dirfd, path, flags | O_RDONLY, mode, resolve);
+			return fd;
+		}
+
+		int openPath(int dirfd, const char *path, int flags, mode_t mode, uint64_t resolve = 0)
+		{
+			int fd = tryOpenPath(dirfd, path, flags, mode, resolve);
+			if (fd < 0)
+				throwErrno(resolve ? "openat2" : "open");
+			return fd;
+		}
+
+		std::unexpected<std::error_code> lastError()
+		{
+			return std::unexpected(std::error_code(errno, std::generic_category()));
+		}
+
+		// What the throwing paths behind the non-throwing API raise, turned back into a code
+		std::unexpected<std::error_code> currentError() noexcept
+		{
+			try
+			{
+				throw;
+			}
+			catch (const std::system_error &error)
+			{
+				return std::unexpected(error.code());
+			}
+			catch (const std::bad_alloc &)
+			{
+				return std::unexpected(std::make_error_code(std::errc::not_enough_memory));
+			}
+			catch (...)
+			{
+				return std::unexpected(std::make_error_code(std::errc::io_error));
+			}
+		}
+
+		int openExactly(int dirfd, const char *path, int flags, mode_t mode, uint64_t resolve = 0)
+		{
+			int fd = detail::openAt(dirfd, path, flags, mode, resolve);
+			if (fd < 0)
+				throwErrno(resolve ? "openat2" : "open");
+			return fd;
+		}
+
+		// A transfer that needs the next way of copying, rather than a real failure
+		bool unsupported(int error)
+		{
+			return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || error == ENOTSUP || error == EBADF || error == ETXTBSY;
+		}
+
+		// Bytes left in [offset, offset + bytes), clamped to the end of a regular file
+		size_t clampToSize(int fd, off_t offset, size_t bytes)
+		{
+			struct stat info;
+			if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+				return offset >= info.st_size ? 0 : std::min<size_t>(bytes, info.st_size - offset);
+			return bytes;
+		}
+
+		// Chunk size for the transfer loops, keeps each system call interruptible
+		constexpr size_t TransferChunk = 1 << 30;
+
+		// pread(2) until bytes are read or end of file, stopping early with block size the offset isn't a multiple of (end of file under O_DIRECT)
+		size_t preadFull(const detail::StatsHandle &stats, int fd, char *buffer, size_t bytes, off_t offset, size_t block = 1)
+		{
+			size_t total = 0;
+			while (total < bytes)
+			{
+				ssize_t got = ::pread(fd, buffer + total, bytes - total, offset + total);
+				stats.count(detail::StatsCounter::ReadCalls);
+				if (got < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					throwErrno("pread");
+				}
+				if (!got)
+					break;
+				stats.count(detail::StatsCounter::BytesRead, got);
+				total += got;
+				if (got % block)
+					break;
+			}
+			return total;
+		}
+
+		void pwriteFull(const detail::StatsHandle &stats, int fd, const char *data, size_t bytes, off_t offset)
+		{
+			detail::StatsTimer timer(stats, detail::StatsLatency::Write);
+			size_t written = 0;
+			while (written < bytes)
+			{
+				ssize_t result = ::pwrite(fd, data + written, bytes - written, offset + written);
+				stats.count(detail::StatsCounter::WriteCalls);
+				if (result < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					throwErrno("pwrite");
+				}
+				stats.count(detail::StatsCounter::BytesWritten, result);
+				written += result;
+			}
+		}
+
+		File::DirectAlignment queryDirectAlignment(int fd)
+		{
+			struct statx info;
+			if (::statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &info) == 0 && (info.stx_mask & STATX_DIOALIGN) && info.stx_dio_offset_align)
+				return {info.stx_dio_mem_align, info.stx_dio_offset_align};
+
+			// Older kernels and filesystems without the query, the filesystem block size is always enough
+			struct stat fallback;
+			size_t block = (::fstat(fd, &fallback) == 0 && fallback.st_blksize > 0) ? fallback.st_blksize : 4096;
+			return {block, block};
+		}
+
+		// Hidden name for a file on its way to being published, O_EXCL or linkat(2) catch the rare collision
+		std::string temporaryName()
+		{
+			static std::atomic<unsigned> counter = 0;
+			char name[64];
+			std::snprintf(name, sizeof(name), ".tmp.%d.%u.%lx", (int)::getpid(), counter.fetch_add(1, std::memory_order_relaxed), (unsigned long)std::chrono::steady_clock::now().time_since_epoch().count());
+			return name;
+		}
+
+		// Gives an O_TMPFILE descriptor a name, AT_EMPTY_PATH needs CAP_DAC_READ_SEARCH so unprivileged callers go through /proc
+		bool linkInto(int fd, int directory, const char *name)
+		{
+			if (::linkat(fd, "", directory, name, AT_EMPTY_PATH) == 0)
+				return true;
+			if (errno != ENOENT && errno != EPERM)
+				return false;
+
+			char path[32];
+			std::snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+			return ::linkat(AT_FDCWD, path, directory, name, AT_SYMLINK_FOLLOW) == 0;
+		}
+
+		bool aligned(size_t value, size_t alignment)
+		{
+			return !(value & (alignment - 1));
+		}
+	} // namespace
+
+	struct File::Unpublished
+	{
+		// Our own duplicate, the Directory passed in may be closed before publish()
+		int directory;
+		// Empty when the file is an O_TMPFILE with no name at all
+		std::string temporaryName;
+
+		explicit Unpublished(int directory) : directory(directory) {}
+		Unpublished(const Unpublished &) = delete;
+		~Unpublished() { ::close(directory); }
+	};
+
+	File::File(int fd, OpenMode flags, size_t readBufferSize)
+		: fd(fd), readBufferSize(readBufferSize ? readBufferSize : DefaultReadBufferSize)
+	{
+		if ((int)flags & O_DIRECT)
+			alignment = queryDirectAlignment(fd);
+	}
+
+	File::File(const char *path, OpenMode flags, Permissions mode, size_t readBufferSize)
+		: File(openPath(AT_FDCWD, path, (int)flags, (mode_t)mode), flags, readBufferSize)
+	{
+	}
+
+	File::File(const char *path, Access access, OpenMode flags, Permissions mode, size_t readBufferSize)
+		: File(openExactly(AT_FDCWD, path, (int)flags | (int)access, (mode_t)mode), flags, readBufferSize)
+	{
+	}
+
+	std::expected<File, std::error_code> File::open(const char *path, OpenMode flags, Permissions mode, size_t readBufferSize) noexcept
+	{
+		int fd = tryOpenPath(AT_FDCWD, path, (int)flags, (mode_t)mode);
+		if (fd < 0)
+			return lastError();
+		try
+		{
+			return File(fd, flags, readBufferSize);
+		}
+		catch (...)
+		{
+			::close(fd);
+			return currentError();
+		}
+	}
+
+	std::expected<File, std::error_code> File::open(const char *path, Access access, OpenMode flags, Permissions mode, size_t readBufferSize) noexcept
+	{
+		int fd = detail::openAt(AT_FDCWD, path, (int)flags | (int)access, (mode_t)mode, 0);
+		if (fd < 0)
+			return lastError();
+		try
+		{
+			return File(fd, flags, readBufferSize);
+		}
+		catch (...)
+		{
+			::close(fd);
+			return currentError();
+		}
+	}
+
+	std::expected<File, std::error_code> File::open(std::string_view path, OpenMode flags, Permissions mode, size_t readBufferSize) noexcept
+	{
+		try
+		{
+			return open(detail::CString(path).c_str(), flags, mode, readBufferSize);
+		}
+		catch (...)
+		{
+			return currentError();
+		}
+	}
+
+	std::expected<File, std::error_code> File::open(std::string_view path, Access access, OpenMode flags, Permissions mode, size_t readBufferSize) noexcept
+	{
+		try
+		{
+			return open(detail::CString(path).c_str(), access, flags, mode, readBufferSize);
+		}
+		catch (...)
+		{
+			return currentError();
+		}
+	}
+
+	File::File(const Directory &directory, std::string_view name, OpenMode flags, Permissions mode, Directory::Resolve resolve, size_t readBufferSize)
+		: File(openPath(directory.descriptor(), detail::CString(name).c_str(), (int)flags, (mode_t)mode, (uint64_t)resolve), flags, readBufferSize)
+	{
+	}
+
+	File::File(const Directory &directory, std::string_view name, Access access, OpenMode flags, Permissions mode, Directory::Resolve resolve, size_t readBufferSize)
+		: File(openExactly(directory.descriptor(), detail::CString(name).c_str(), (int)flags | (int)access, (mode_t)mode, (uint64_t)resolve), flags, readBufferSize)
+	{
+	}
+
+	File::File(File &&other)
+		: fd(other.fd), resource(other.resource), readBuffer(std::move(other.readBuffer)), readBufferCapacity(other.readBufferCapacity), readBufferSize(other.readBufferSize), readBegin(other.readBegin), readEnd(other.readEnd), blocked(other.blocked), unseekable(other.unseekable),
+		  delimiter(other.delimiter), scanState(other.scanState),
+		  writeBuffer(std::move(other.writeBuffer)), writeBufferSize(other.writeBufferSize), writeBufferUsed(other.writeBufferUsed), writeHighWaterMark(other.writeHighWaterMark),
+		  preallocationStep(other.preallocationStep), preallocatedEnd(other.preallocatedEnd),
+		  alignment(other.alignment), unpublished(std::move(other.unpublished)), statsHandle(std::move(other.statsHandle))
+	{
+		other.fd = -1;
+		other.writeBufferSize = other.writeBufferUsed = 0;
+		other.readBufferCapacity = 0;
+		other.readBegin = other.readEnd = 0;
+	}
+
+	File::~File()
+	{
+		if (fd < 0)
+			return;
+
+		try
+		{
+			flush();
+		}
+		catch (const std::system_error &)
+		{
+			// Nowhere to report it, the data is lost either way
+		}
+		::close(fd);
+
+		// An unpublished O_TMPFILE vanishes with its descriptor, the named fallback has to be removed
+		if (unpublished && !unpublished->temporaryName.empty())
+			::unlinkat(unpublished->directory, unpublished->temporaryName.c_str(), 0);
+	}
+
+	int File::release()
+	{
+		flush();
+		discardReadAhead();
+		unpublished.reset();
+		int released = fd;
+		fd = -1;
+		return released;
+	}
+
+	File File::createAnonymous(const Directory &directory, Permissions mode)
+	{
+		int duplicate = ::fcntl(directory.descriptor(), F_DUPFD_CLOEXEC, 0);
+		if (duplicate < 0)
+			throwErrno("fcntl");
+		auto pending = std::make_unique<Unpublished>(duplicate);
+
+		int fd = detail::openAt(duplicate, ".", O_TMPFILE | O_RDWR, (mode_t)mode, 0);
+		// EOPNOTSUPP from filesystems without O_TMPFILE, EISDIR from kernels older than it
+		if (fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR))
+		{
+			for (unsigned attempt = 0; attempt < 64; attempt++)
+			{
+				std::string name = temporaryName();
+				fd = detail::openAt(duplicate, name.c_str(), O_CREAT | O_EXCL | O_RDWR, (mode_t)mode, 0);
+				if (fd >= 0)
+				{
+					pending->temporaryName = std::move(name);
+					break;
+				}
+				if (errno != EEXIST)
+					break;
+			}
+		}
+		if (fd < 0)
+			throwErrno("open");
+
+		File file(fd, (OpenMode)0, DefaultReadBufferSize);
+		file.unpublished = std::move(pending);
+		return file;
+	}
+
+	File File::createAnonymous(std::string_view directory, Permissions mode)
+	{
+		return createAnonymous(Directory(directory), mode);
+	}
+
+	File &File::publish(std::string_view name, bool replace)
+	{
+		if (!unpublished)
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "publish: file wasn't made by createAnonymous");
+
+		flush();
+		const int directory = unpublished->directory;
+		detail::CString target(name);
+
+		if (unpublished->temporaryName.empty())
+		{
+			if (!replace)
+			{
+				if (!linkInto(fd, directory, target.c_str()))
+					throwErrno("linkat");
+			}
+			else
+			{
+				// linkat(2) never replaces, so link under a name no one uses and rename(2) that over the target
+				std::string staging;
+				for (unsigned attempt = 0;; attempt++)
+				{
+					staging = temporaryName();
+					if (linkInto(fd, directory, staging.c_str()))
+						break;
+					if (errno != EEXIST || attempt == 63)
+						throwErrno("linkat");
+				}
+				if (::renameat(directory, staging.c_str(), directory, target.c_str()) < 0)
+				{
+					int error = errno;
+					::unlinkat(directory, staging.c_str(), 0);
+					errno = error;
+					throwErrno("renameat");
+				}
+			}
+		}
+		else
+		{
+			const char *staging = unpublished->temporaryName.c_str();
+			if (replace)
+			{
+				if (::renameat(directory, staging, directory, target.c_str()) < 0)
+					throwErrno("renameat");
+			}
+			else if (::renameat2(directory, staging, directory, target.c_str(), RENAME_NOREPLACE) < 0)
+			{
+				if (errno != EINVAL && errno != ENOSYS)
+					throwErrno("renameat2");
+				// No RENAME_NOREPLACE on this filesystem, linkat(2) refuses an existing target just the same
+				if (::linkat(directory, staging, directory, target.c_str(), 0) < 0)
+					throwErrno("linkat");
+				::unlinkat(directory, staging, 0);
+			}
+		}
+
+		unpublished.reset();
+		return *this;
+	}
+
+	off_t File::seek(off_t offset, int whence)
+	{
+		flush();
+		discardReadAhead();
+		scanState.reset();
+		off_t position = ::lseek(fd, offset, whence);
+		if (position < 0)
+			throwErrno("lseek");
+		return position;
+	}
+
+	bool File::seekLine(const LineIndex &index, uint64_t line)
+	{
+		if (line >= index.lines())
+		{
+			seek(0, SEEK_END);
+			return false;
+		}
+
+		const LineIndex::Position position = index.locate(line);
+		seek(position.offset);
+		for (size_t skipped = 0; skipped < position.skip; skipped++)
+		{
+			if (!readLineView())
+				return false;
+		}
+		return true;
+	}
+
+	void File::setReadBufferSize(size_t bytes)
+	{
+		readBufferSize = bytes ? bytes : DefaultReadBufferSize;
+	}
+
+	void File::setDelimiter(std::string_view delimiter)
+	{
+		this->delimiter = DelimiterScanner(delimiter);
+		scanState.reset();
+	}
+
+	bool File::fillReadBuffer()
+	{
+		// Whatever happens below, the bytes move or get replaced
+		scanState.reset();
+
+		if (readBegin == readEnd)
+		{
+			// Only reallocate once everything buffered has been consumed, so a grown buffer shrinks back here
+			readBegin = readEnd = 0;
+			if (readBufferCapacity != readBufferSize)
+			{
+				readBuffer = allocateBuffer(readBufferSize);
+				readBufferCapacity = readBufferSize;
+			}
+		}
+		else if (readBegin != 0)
+		{
+			std::memmove(readBuffer.get(), readBuffer.get() + readBegin, readEnd - readBegin);
+			readEnd -= readBegin;
+			readBegin = 0;
+		}
+
+		if (readEnd == readBufferCapacity)
+		{
+			// A single line fills the whole buffer
+			Buffer grown = allocateBuffer(readBufferCapacity * 2);
+			std::memcpy(grown.get(), readBuffer.get(), readEnd);
+			readBuffer = std::move(grown);
+			readBufferCapacity *= 2;
+		}
+
+		flush();
+
+		statsHandle.count(detail::StatsCounter::Refills);
+		blocked = false;
+		ssize_t got = alignment.offset ? (ssize_t)readSome(readBuffer.get() + readEnd, readBufferCapacity - readEnd) : readOnce(readBuffer.get() + readEnd, readBufferCapacity - readEnd);
+		if (got < 0)
+		{
+			// A non-blocking descriptor with nothing more for now, not the end of the file
+			if (errno != EAGAIN)
+				throwErrno("read");
+			blocked = true;
+			return false;
+		}
+		readEnd += got;
+		return got > 0;
+	}
+
+	size_t File::readSome(char *buffer, size_t bytes)
+	{
+		if (alignment.offset)
+		{
+			off_t offset = ::lseek(fd, 0, SEEK_CUR);
+			if (offset < 0)
+				throwErrno("lseek");
+			size_t got = readDirect(offset, buffer, bytes);
+			if (::lseek(fd, offset + got, SEEK_SET) < 0)
+				throwErrno("lseek");
+			return got;
+		}
+
+		ssize_t got = readOnce(buffer, bytes);
+		if (got < 0)
+			throwErrno("read");
+		return got;
+	}
+
+	ssize_t File::readOnce(char *buffer, size_t bytes) noexcept
+	{
+		ssize_t got;
+		do
+		{
+			got = ::read(fd, buffer, bytes);
+			statsHandle.count(detail::StatsCounter::ReadCalls);
+		} while (got < 0 && errno == EINTR);
+
+		if (got > 0)
+			statsHandle.count(detail::StatsCounter::BytesRead, got);
+		return got;
+	}
+
+	ssize_t File::writeOnce(const char *data, size_t bytes) noexcept
+	{
+		ssize_t result;
+		do
+		{
+			result = ::write(fd, data, bytes);
+			statsHandle.count(detail::StatsCounter::WriteCalls);
+		} while (result < 0 && errno == EINTR);
+
+		if (result > 0)
+			statsHandle.count(detail::StatsCounter::BytesWritten, result);
+		return result;
+	}
+
+	size_t File::readDirect(off_t offset, char *buffer, size_t bytes) const
+	{
+		const size_t block = alignment.offset;
+		if (aligned((uintptr_t)buffer, alignment.memory) && aligned(offset, block) && aligned(bytes, block))
+			return preadFull(statsHandle, fd, buffer, bytes, offset, block);
+
+		off_t start = offset & ~(off_t)(block - 1);
+		size_t span = ((offset + bytes + block - 1) & ~(block - 1)) - start;
+		AlignedBuffer bounce = AlignedBufferPool::shared().acquire(span, std::max(alignment.memory, block));
+
+		size_t got = preadFull(statsHandle, fd, bounce.data(), span, start, block);
+		size_t skip = offset - start;
+		if (got <= skip)
+			return 0;
+		size_t copied = std::min(bytes, got - skip);
+		std::memcpy(buffer, bounce.data() + skip, copied);
+		return copied;
+	}
+
+	void File::writeDirect(off_t offset, const char *data, size_t bytes) const
+	{
+		const size_t block = alignment.offset;
+		// Every direct write holds this shared, only trimming the padding of a tail block takes it exclusively
+		std::shared_lock<std::shared_mutex> writing(directSizeMutex);
+		if (aligned((uintptr_t)data, alignment.memory) && aligned(offset, block) && aligned(bytes, block))
+		{
+			pwriteFull(statsHandle, fd, data, bytes, offset);
+			return;
+		}
+
+		struct stat info;
+		if (::fstat(fd, &info) < 0)
+			throwErrno("fstat");
+
+		off_t start = offset & ~(off_t)(block - 1);
+		off_t end = (offset + bytes + block - 1) & ~(off_t)(block - 1);
+		size_t span = end - start;
+		AlignedBuffer bounce = AlignedBufferPool::shared().acquire(span, std::max(alignment.memory, block));
+		std::memset(bounce.data(), 0, span);
+
+		// Keep whatever already shares the first and last block with the new data
+		if (!aligned(offset, block))
+			preadFull(statsHandle, fd, bounce.data(), block, start, block);
+		if (!aligned(offset + bytes, block) && (end - (off_t)block != start || aligned(offset, block)))
+			preadFull(statsHandle, fd, bounce.data() + span - block, block, end - block, block);
+
+		std::memcpy(bounce.data() + (offset - start), data, bytes);
+		pwriteFull(statsHandle, fd, bounce.data(), span, start);
+
+		// The padding of the last block mustn't become part of the file
+		off_t size = std::max<off_t>(info.st_size, offset + bytes);
+		if (end <= size)
+			return;
+
+		// Only shrink while the file still ends exactly at this padding, a concurrent write may have extended it past
+		// since; with no write in flight between the check and ftruncate that extension can't be cut off either
+		writing.unlock();
+		std::unique_lock<std::shared_mutex> trimming(directSizeMutex);
+		if (::fstat(fd, &info) < 0)
+			throwErrno("fstat");
+		if (info.st_size == end && ::ftruncate(fd, size) < 0)
+			throwErrno("ftruncate");
+	}
+
+	bool File::ensureReadable(size_t bytes)
+	{
+		while (readEnd - readBegin < bytes)
+		{
+			if (!fillReadBuffer())
+				return false;
+		}
+		return true;
+	}
+
+	void File::throwTruncatedRecord()
+	{
+		throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "readRecord: truncated record");
+	}
+
+	bool Framing::Varint::frame(const char *data, size_t available, size_t &header, size_t &body)
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < available && i < 10; i++)
+		{
+			unsigned char byte = data[i];
+			value |= (uint64_t)(byte & 0x7f) << (7 * i);
+			if (!(byte & 0x80))
+			{
+				header = i + 1;
+				body = value;
+				return true;
+			}
+		}
+		if (available >= 10)
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "readRecord: varint longer than 10 bytes");
+		return false;
+	}
+
+	bool File::rewindReadAhead() noexcept
+	{
+		if (readBegin == readEnd)
+		{
+			readBegin = readEnd = 0;
+			return true;
+		}
+		// Pipes, FIFOs, sockets and ttys can't take the bytes back, they stay buffered for the next read instead
+		if (unseekable)
+			return true;
+		if (::lseek(fd, -(off_t)(readEnd - readBegin), SEEK_CUR) < 0)
+		{
+			if (errno != ESPIPE)
+				return false;
+			unseekable = true;
+			return true;
+		}
+		readBegin = readEnd = 0;
+		return true;
+	}
+
+	void File::discardReadAhead()
+	{
+		if (!rewindReadAhead())
+			throwErrno("lseek");
+	}
+
+	std::optional<std::string> File::readLine()
+	{
+		if (auto line = readLineView())
+			return std::string(*line);
+		return std::nullopt;
+	}
+
+	bool File::readLine(std::string &out)
+	{
+		auto line = readLineView();
+		if (!line)
+			return false;
+		out.assign(*line);
+		return true;
+	}
+
+	bool File::readLine(std::pmr::string &out)
+	{
+		auto line = readLineView();
+		if (!line)
+			return false;
+		out.assign(*line);
+		return true;
+	}
+
+	template <typename String>
+	void File::readRemaining(String &out)
+	{
+		flush();
+		const size_t buffered = readEnd - readBegin;
+
+		// What is left past the file offset, unknown (0) when the size isn't meaningful or the fd can't seek
+		size_t expected = 0;
+		struct statx info;
+		if (::statx(fd, "", AT_EMPTY_PATH, STATX_SIZE, &info) == 0 && (info.stx_mask & STATX_SIZE) && info.stx_size)
+		{
+			off_t offset = ::lseek(fd, 0, SEEK_CUR);
+			if (offset >= 0 && (uint64_t)offset < info.stx_size)
+				expected = info.stx_size - offset;
+		}
+
+		std::exception_ptr failure;
+		size_t length = 0;
+		bool done = false;
+		// resize_and_overwrite() must not be left by an exception, so a failed read is rethrown after it returns
+		auto fill = [&](char *data, size_t size) -> size_t
+		{
+			try
+			{
+				if (!length && buffered)
+				{
+					std::memcpy(data, readBuffer.get() + readBegin, buffered);
+					length = buffered;
+					readBegin = readEnd = 0;
+					scanState.reset();
+				}
+				while (length < size)
+				{
+					size_t wanted = size - length;
+					size_t got = readSome(data + length, wanted);
+					length += got;
+					// One read(2) returns at most 0x7ffff000 bytes and signals or network filesystems cut others short,
+					// so only reaching the known size ends early; the extra byte asked for there already proved nothing follows
+					if (!got || (expected && length >= buffered + expected && got < wanted))
+					{
+						done = true;
+						break;
+					}
+				}
+			}
+			catch (...)
+			{
+				failure = std::current_exception();
+				done = true;
+			}
+			return length;
+		};
+
+		out.clear();
+		// One byte more than expected, so the read that gets everything comes up short and proves the end
+		size_t capacity = expected ? buffered + expected + 1 : buffered + readBufferSize;
+		while (true)
+		{
+			out.resize_and_overwrite(capacity, fill);
+			if (done)
+				break;
+			// Filled up, the file grew since statx() or never said how big it is
+			expected = 0;
+			capacity *= 2;
+		}
+		if (failure)
+			std::rethrow_exception(failure);
+	}
+
+	std::string File::readAll()
+	{
+		std::string out;
+		readRemaining(out);
+		return out;
+	}
+
+	std::string &File::readAllInto(std::string &out)
+	{
+		readRemaining(out);
+		return out;
+	}
+
+	std::pmr::string &File::readAllInto(std::pmr::string &out)
+	{
+		readRemaining(out);
+		return out;
+	}
+
+	std::optional<std::string_view> File::readLineView()
+	{
+		return nextLine(true);
+	}
+
+	std::optional<std::string_view> File::readCompleteLineView()
+	{
+		return nextLine(false);
+	}
+
+	std::optional<std::string_view> File::nextLine(bool takePartial)
+	{
+		// Bytes before this have already been searched for a delimiter
+		size_t scanned = readBegin;
+
+		while (true)
+		{
+			const char *buffer = readBuffer.get();
+			size_t found = readEnd > scanned ? delimiter.find(buffer, readEnd, scanned, scanState) : DelimiterScanner::npos;
+			if (found != DelimiterScanner::npos)
+			{
+				std::string_view line(buffer + readBegin, found - readBegin);
+				readBegin = found + delimiter.size();
+				return line;
+			}
+
+			// A delimiter may straddle the end of what has been read so far, and a refill moves the unconsumed bytes to the front
+			size_t partial = std::min(delimiter.size() - 1, readEnd - readBegin);
+			scanned = readEnd - partial - readBegin;
+			if (!fillReadBuffer())
+				break;
+			scanned += readBegin;
+		}
+
+		// A final line without a trailing delimiter, unless the rest of it just hasn't arrived yet
+		if (readBegin == readEnd || !takePartial || blocked)
+			return std::nullopt;
+		std::string_view last(readBuffer.get() + readBegin, readEnd - readBegin);
+		readBegin = readEnd;
+		return last;
+	}
+
+	File &File::write(const std::string &data)
+	{
+		return write(data.data(), data.size());
+	}
+
+	File &File::write(const char *const data, const size_t bytes)
+	{
+		discardReadAhead();
+
+		if (bytes >= writeHighWaterMark || !writeBufferSize)
+		{
+			flush();
+			writeAll(data, bytes);
+			return *this;
+		}
+
+		if (writeBufferUsed + bytes > writeBufferSize)
+			flush();
+		if (!writeBuffer)
+			writeBuffer = allocateBuffer(writeBufferSize);
+		std::memcpy(writeBuffer.get() + writeBufferUsed, data, bytes);
+		writeBufferUsed += bytes;
+		return *this;
+	}
+
+	void File::extendPreallocation(size_t bytes)
+	{
+		off_t offset = ::lseek(fd, 0, SEEK_CUR);
+		if (offset < 0 || offset + (off_t)bytes + (off_t)(preallocationStep / 2) <= preallocatedEnd)
+			return;
+
+		off_t length = bytes + preallocationStep;
+		int result;
+		do
+			result = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, length);
+		while (result < 0 && errno == EINTR);
+
+		if (result == 0)
+			preallocatedEnd = offset + length;
+		else if (unsupported(errno))
+			preallocationStep = 0;
+		// Anything else, ENOSPC say, is left for the write itself to report
+	}
+
+	void File::writeAll(const char *data, size_t bytes)
+	{
+		if (preallocationStep)
+			extendPreallocation(bytes);
+
+		if (alignment.offset)
+		{
+			off_t offset = ::lseek(fd, 0, SEEK_CUR);
+			if (offset < 0)
+				throwErrno("lseek");
+			writeDirect(offset, data, bytes);
+			if (::lseek(fd, offset + bytes, SEEK_SET) < 0)
+				throwErrno("lseek");
+			return;
+		}
+
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::Write);
+		size_t written = 0;
+		while (written < bytes)
+		{
+			ssize_t result = writeOnce(data + written, bytes - written);
+			if (result < 0)
+				throwErrno("write");
+			written += result;
+		}
+	}
+
+	void File::writeAll(std::span<const iovec> buffers)
+	{
+		if (alignment.offset)
+		{
+			// Gather into one buffer so the whole write pays for at most one read-modify-write
+			size_t total = 0;
+			for (const iovec &buffer : buffers)
+				total += buffer.iov_len;
+			AlignedBuffer gathered = AlignedBufferPool::shared().acquire(total, std::max(alignment.memory, alignment.offset));
+			size_t at = 0;
+			for (const iovec &buffer : buffers)
+			{
+				std::memcpy(gathered.data() + at, buffer.iov_base, buffer.iov_len);
+				at += buffer.iov_len;
+			}
+			writeAll(gathered.data(), total);
+			return;
+		}
+
+		if (preallocationStep)
+		{
+			size_t total = 0;
+			for (const iovec &buffer : buffers)
+				total += buffer.iov_len;
+			extendPreallocation(total);
+		}
+
+		const iovec *next = buffers.data();
+		size_t count = buffers.size();
+
+		// Only copied if a short write leaves a partly written buffer to adjust
+		std::vector<iovec> remaining;
+
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::Write);
+		while (count)
+		{
+			ssize_t result = ::writev(fd, next, (int)std::min<size_t>(count, IOV_MAX));
+			statsHandle.count(detail::StatsCounter::WriteCalls);
+			if (result < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throwErrno("writev");
+			}
+			statsHandle.count(detail::StatsCounter::BytesWritten, result);
+
+			size_t done = result;
+			while (count && done >= next->iov_len)
+			{
+				done -= next->iov_len;
+				++next;
+				--count;
+			}
+			if (count && done)
+			{
+				if (remaining.empty() || next < remaining.data() || next >= remaining.data() + remaining.size())
+				{
+					remaining.assign(next, next + count);
+					next = remaining.data();
+				}
+				iovec &partial = remaining[next - remaining.data()];
+				partial.iov_base = (char *)partial.iov_base + done;
+				partial.iov_len -= done;
+			}
+		}
+	}
+
+	File &File::write(std::span<const iovec> buffers)
+	{
+		size_t total = 0;
+		for (const iovec &buffer : buffers)
+			total += buffer.iov_len;
+
+		if (writeBufferSize && total < writeHighWaterMark)
+		{
+			for (const iovec &buffer : buffers)
+				write((const char *)buffer.iov_base, buffer.iov_len);
+			return *this;
+		}
+
+		discardReadAhead();
+		flush();
+		writeAll(buffers);
+		return *this;
+	}
+
+	File &File::write(std::initializer_list<std::string_view> buffers)
+	{
+		auto gather = [](std::string_view data)
+		{ return iovec{(void *)data.data(), data.size()}; };
+
+		std::array<iovec, 8> small;
+		if (buffers.size() <= small.size())
+		{
+			std::transform(buffers.begin(), buffers.end(), small.begin(), gather);
+			return write(std::span<const iovec>(small.data(), buffers.size()));
+		}
+
+		std::vector<iovec> large(buffers.size());
+		std::transform(buffers.begin(), buffers.end(), large.begin(), gather);
+		return write(std::span<const iovec>(large));
+	}
+
+	size_t File::read(std::span<const iovec> buffers)
+	{
+		size_t total = 0;
+		size_t index = 0;
+		size_t filled = 0;
+
+		// Hand out what was already read ahead before going back to the file
+		while (index < buffers.size() && readBegin != readEnd)
+		{
+			size_t bytes = std::min(buffers[index].iov_len - filled, readEnd - readBegin);
+			std::memcpy((char *)buffers[index].iov_base + filled, readBuffer.get() + readBegin, bytes);
+			readBegin += bytes;
+			filled += bytes;
+			total += bytes;
+			if (filled == buffers[index].iov_len)
+			{
+				++index;
+				filled = 0;
+			}
+		}
+		if (index == buffers.size())
+			return total;
+
+		flush();
+
+		if (alignment.offset)
+		{
+			size_t wanted = buffers[index].iov_len - filled;
+			for (size_t i = index + 1; i < buffers.size(); i++)
+				wanted += buffers[i].iov_len;
+			AlignedBuffer bounce = AlignedBufferPool::shared().acquire(wanted, std::max(alignment.memory, alignment.offset));
+			size_t got = readSome(bounce.data(), wanted);
+
+			for (size_t at = 0; at < got; index++, filled = 0)
+			{
+				size_t bytes = std::min(buffers[index].iov_len - filled, got - at);
+				std::memcpy((char *)buffers[index].iov_base + filled, bounce.data() + at, bytes);
+				at += bytes;
+			}
+			return total + got;
+		}
+
+		std::vector<iovec> remaining(buffers.begin() + index, buffers.end());
+		remaining.front().iov_base = (char *)remaining.front().iov_base + filled;
+		remaining.front().iov_len -= filled;
+
+		ssize_t got;
+		do
+		{
+			got = ::readv(fd, remaining.data(), (int)std::min<size_t>(remaining.size(), IOV_MAX));
+			statsHandle.count(detail::StatsCounter::ReadCalls);
+		} while (got < 0 && errno == EINTR);
+
+		if (got < 0)
+		{
+			// Report what was handed out of the buffer rather than losing it
+			if (total)
+				return total;
+			throwErrno("readv");
+		}
+		statsHandle.count(detail::StatsCounter::BytesRead, got);
+		return total + got;
+	}
+
+	std::optional<size_t> File::write(std::span<const iovec> buffers, off_t offset, IoFlags flags)
+	{
+		if (offset < 0)
+			discardReadAhead();
+		flush();
+
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::Write);
+		ssize_t result;
+		do
+		{
+			result = ::pwritev2(fd, buffers.data(), (int)std::min<size_t>(buffers.size(), IOV_MAX), offset, (int)flags);
+			statsHandle.count(detail::StatsCounter::WriteCalls);
+		} while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+		{
+			if (((int)flags & RWF_NOWAIT) && (errno == EAGAIN || errno == EOPNOTSUPP))
+				return std::nullopt;
+			throwErrno("pwritev2");
+		}
+		statsHandle.count(detail::StatsCounter::BytesWritten, result);
+		return result;
+	}
+
+	std::optional<size_t> File::read(std::span<const iovec> buffers, off_t offset, IoFlags flags)
+	{
+		if (offset < 0)
+			discardReadAhead();
+		flush();
+
+		ssize_t result;
+		do
+		{
+			result = ::preadv2(fd, buffers.data(), (int)std::min<size_t>(buffers.size(), IOV_MAX), offset, (int)flags);
+			statsHandle.count(detail::StatsCounter::ReadCalls);
+		} while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+		{
+			if (((int)flags & RWF_NOWAIT) && (errno == EAGAIN || errno == EOPNOTSUPP))
+				return std::nullopt;
+			throwErrno("preadv2");
+		}
+		statsHandle.count(detail::StatsCounter::BytesRead, result);
+		return result;
+	}
+
+	size_t File::readAt(off_t offset, char *const buffer, const size_t bytes) const
+	{
+		if (alignment.offset)
+			return readDirect(offset, buffer, bytes);
+		return preadFull(statsHandle, fd, buffer, bytes, offset);
+	}
+
+	const File &File::writeAt(off_t offset, const char *const data, const size_t bytes) const
+	{
+		if (alignment.offset)
+			writeDirect(offset, data, bytes);
+		else
+			pwriteFull(statsHandle, fd, data, bytes, offset);
+		return *this;
+	}
+
+	size_t File::copyTo(File &dst, off_t offset, size_t bytes)
+	{
+		flush();
+		dst.discardReadAhead();
+		dst.flush();
+
+		bytes = clampToSize(fd, offset, bytes);
+		if (!bytes)
+			return 0;
+
+		off_t dstOffset = ::lseek(dst.fd, 0, SEEK_CUR);
+		if (dstOffset >= 0)
+		{
+			// Shares the extents outright on filesystems with reflinks, needs block aligned offsets
+			file_clone_range clone = {fd, (uint64_t)offset, (uint64_t)bytes, (uint64_t)dstOffset};
+			if (::ioctl(dst.fd, FICLONERANGE, &clone) == 0)
+			{
+				if (::lseek(dst.fd, dstOffset + bytes, SEEK_SET) < 0)
+					throwErrno("lseek");
+				return bytes;
+			}
+		}
+
+		size_t copied = 0;
+		bool useCopyFileRange = true;
+		bool useSendfile = true;
+		while (copied < bytes)
+		{
+			size_t chunk = std::min(bytes - copied, TransferChunk);
+			off_t from = offset + copied;
+			ssize_t result;
+			if (useCopyFileRange)
+			{
+				result = ::copy_file_range(fd, &from, dst.fd, nullptr, chunk, 0);
+				if (result < 0 && unsupported(errno) && !copied)
+				{
+					useCopyFileRange = false;
+					continue;
+				}
+			}
+			else if (useSendfile)
+			{
+				result = ::sendfile(dst.fd, fd, &from, chunk);
+				if (result < 0 && unsupported(errno) && !copied)
+				{
+					useSendfile = false;
+					continue;
+				}
+			}
+			else
+			{
+				char buffer[64 * 1024];
+				result = readAt(from, buffer, std::min(chunk, sizeof(buffer)));
+				dst.writeAll(buffer, result);
+			}
+
+			if (result < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				// The read and write fallback throws on its own
+				throwErrno(useCopyFileRange ? "copy_file_range" : "sendfile");
+			}
+			// The source shrank underneath us
+			if (!result)
+				break;
+			copied += result;
+		}
+		return copied;
+	}
+
+	size_t File::sendTo(int socketFd, off_t offset, size_t bytes)
+	{
+		flush();
+
+		bytes = clampToSize(fd, offset, bytes);
+		size_t sent = 0;
+
+		while (sent < bytes)
+		{
+			off_t from = offset + sent;
+			ssize_t result = ::sendfile(socketFd, fd, &from, std::min(bytes - sent, TransferChunk));
+			if (result < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN)
+					return sent;
+				if (unsupported(errno) && !sent)
+					break;
+				throwErrno("sendfile");
+			}
+			if (!result)
+				return sent;
+			sent += result;
+		}
+		if (sent == bytes)
+			return sent;
+
+		// sendfile(2) refused this pair of descriptors, move the pages through a pipe instead
+		int pipeFds[2];
+		if (::pipe2(pipeFds, O_CLOEXEC) == 0)
+		{
+			bool spliced = true;
+			while (sent < bytes)
+			{
+				loff_t from = offset + sent;
+				ssize_t in = ::splice(fd, &from, pipeFds[1], nullptr, std::min(bytes - sent, TransferChunk), SPLICE_F_MOVE);
+				if (in < 0 && errno == EINTR)
+					continue;
+				if (in <= 0)
+				{
+					spliced = in == 0;
+					break;
+				}
+
+				ssize_t out = 0;
+				while (out < in)
+				{
+					ssize_t moved = ::splice(pipeFds[0], nullptr, socketFd, nullptr, in - out, SPLICE_F_MOVE | SPLICE_F_MORE);
+					if (moved < 0 && errno == EINTR)
+						continue;
+					// Whatever is left in the pipe can't be put back, but it was read past, so fail loudly below
+					if (moved <= 0)
+						break;
+					out += moved;
+				}
+				sent += out;
+				if (out < in)
+				{
+					int error = errno;
+					::close(pipeFds[0]);
+					::close(pipeFds[1]);
+					if (error == EAGAIN)
+						return sent;
+					errno = error;
+					throwErrno("splice");
+				}
+			}
+			::close(pipeFds[0]);
+			::close(pipeFds[1]);
+			if (spliced || sent)
+				return sent;
+		}
+
+		char buffer[64 * 1024];
+		while (sent < bytes)
+		{
+			size_t got = readAt(offset + sent, buffer, std::min(bytes - sent, sizeof(buffer)));
+			if (!got)
+				break;
+
+			size_t out = 0;
+			while (out < got)
+			{
+				ssize_t result = ::write(socketFd, buffer + out, got - out);
+				if (result < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					if (errno == EAGAIN)
+						return sent + out;
+					throwErrno("write");
+				}
+				out += result;
+			}
+			sent += got;
+		}
+		return sent;
+	}
+
+	File &File::reserve(off_t bytes)
+	{
+		int result;
+		do
+			result = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, bytes);
+		while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+			throwErrno("fallocate");
+		preallocatedEnd = std::max(preallocatedEnd, bytes);
+		return *this;
+	}
+
+	File &File::punchHole(off_t offset, off_t bytes)
+	{
+		flush();
+		int result;
+		do
+			result = ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, bytes);
+		while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+			throwErrno("fallocate");
+		// The read-ahead may hold bytes that are now zeroes
+		discardReadAhead();
+		scanState.reset();
+		return *this;
+	}
+
+	File &File::advise(Advice advice, off_t offset, off_t bytes)
+	{
+		flush();
+		// Returns the error rather than setting errno
+		errno = ::posix_fadvise(fd, offset, bytes, (int)advice);
+		if (errno)
+			throwErrno("posix_fadvise");
+		return *this;
+	}
+
+	void File::setPreallocation(size_t step)
+	{
+		preallocationStep = step;
+	}
+
+	void File::setWriteBufferSize(size_t bytes, size_t highWaterMark)
+	{
+		flush();
+		writeBuffer.reset();
+		writeBufferSize = bytes;
+		writeHighWaterMark = (highWaterMark && highWaterMark < bytes) ? highWaterMark : bytes;
+	}
+
+	File &File::flush()
+	{
+		if (writeBufferUsed)
+		{
+			// Forget the data before writing so a failure doesn't write it twice on the next flush
+			size_t bytes = writeBufferUsed;
+			writeBufferUsed = 0;
+			writeAll(writeBuffer.get(), bytes);
+		}
+		return *this;
+	}
+
+	std::error_code File::drainWriteBuffer() noexcept
+	{
+		size_t written = 0;
+		std::error_code error;
+		while (written < writeBufferUsed)
+		{
+			ssize_t result = writeOnce(writeBuffer.get() + written, writeBufferUsed - written);
+			if (result < 0)
+			{
+				error = std::error_code(errno, std::generic_category());
+				break;
+			}
+			written += result;
+		}
+		// What didn't go out stays buffered, in order, for the next attempt
+		std::memmove(writeBuffer.get(), writeBuffer.get() + written, writeBufferUsed - written);
+		writeBufferUsed -= written;
+		return error;
+	}
+
+	std::expected<void, std::error_code> File::tryFlush() noexcept
+	{
+		if (std::error_code error = drainWriteBuffer())
+			return std::unexpected(error);
+		return {};
+	}
+
+	std::expected<size_t, std::error_code> File::tryWrite(const char *data, size_t bytes) noexcept
+	{
+		if (!rewindReadAhead())
+			return lastError();
+		if (writeBufferUsed)
+		{
+			if (std::error_code error = drainWriteBuffer())
+				return std::unexpected(error);
+		}
+
+		// Preallocation and O_DIRECT bouncing only exist on the throwing path, which always writes everything
+		if (preallocationStep || alignment.offset)
+		{
+			try
+			{
+				writeAll(data, bytes);
+				return bytes;
+			}
+			catch (...)
+			{
+				return currentError();
+			}
+		}
+
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::Write);
+		ssize_t result = writeOnce(data, bytes);
+		if (result < 0)
+			return lastError();
+		return (size_t)result;
+	}
+
+	std::expected<size_t, std::error_code> File::tryRead(char *buffer, size_t bytes) noexcept
+	{
+		if (readBegin != readEnd)
+		{
+			size_t taken = std::min(bytes, readEnd - readBegin);
+			std::memcpy(buffer, readBuffer.get() + readBegin, taken);
+			readBegin += taken;
+			return taken;
+		}
+		if (writeBufferUsed)
+		{
+			if (std::error_code error = drainWriteBuffer())
+				return std::unexpected(error);
+		}
+
+		if (alignment.offset)
+		{
+			try
+			{
+				return readSome(buffer, bytes);
+			}
+			catch (...)
+			{
+				return currentError();
+			}
+		}
+
+		ssize_t got = readOnce(buffer, bytes);
+		if (got < 0)
+			return lastError();
+		return (size_t)got;
+	}
+
+	File &File::sync(bool dataOnly)
+	{
+		flush();
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::Sync);
+		int result;
+		do
+		{
+			result = dataOnly ? ::fdatasync(fd) : ::fsync(fd);
+			statsHandle.count(detail::StatsCounter::SyncCalls);
+		} while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+			throwErrno(dataOnly ? "fdatasync" : "fsync");
+		return *this;
+	}
+
+	void File::lock()
+	{
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::LockWait);
+		mutex.lock();
+		int result;
+		do
+			result = ::flock(fd, LOCK_EX);
+		while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+		{
+			mutex.unlock();
+			throwErrno("flock");
+		}
+	}
+
+	void File::unlock()
+	{
+		// Release the lock even if the data can't be written, then report it
+		std::exception_ptr error;
+		try
+		{
+			flush();
+		}
+		catch (const std::system_error &)
+		{
+			error = std::current_exception();
+		}
+
+		::flock(fd, LOCK_UN);
+		mutex.unlock();
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	bool File::try_lock()
+	{
+		if (!mutex.try_lock())
+			return false;
+
+		int result;
+		do
+			result = ::flock(fd, LOCK_EX | LOCK_NB);
+		while (result < 0 && errno == EINTR);
+
+		if (result < 0)
+		{
+			mutex.unlock();
+			if (errno == EWOULDBLOCK)
+				return false;
+			throwErrno("flock");
+		}
+		return true;
+	}
+
+	void File::lock_shared()
+	{
+		detail::StatsTimer timer(statsHandle, detail::StatsLatency::LockWait);
+		mutex.lock_shared();
+
+		std::lock_guard<std::mutex> guard(sharedFlockMutex);
+		if (sharedHolders == 0)
+		{
+			int result;
+			do
+				result = ::flock(fd, LOCK_SH);
+			while (result < 0 && errno == EINTR);
+
+			if (result < 0)
+			{
+				mutex.unlock_shared();
+				throwErrno("flock");
+			}
+		}
+		++sharedHolders;
+	}
+
+	void File::unlock_shared()
+	{
+		{
+			std::lock_guard<std::mutex> guard(sharedFlockMutex);
+			if (--sharedHolders == 0)
+				::flock(fd, LOCK_UN);
+		}
+		mutex.unlock_shared();
+	}
+
+	bool File::try_lock_shared()
+	{
+		if (!mutex.try_lock_shared())
+			return false;
+
+		std::lock_guard<std::mutex> guard(sharedFlockMutex);
+		if (sharedHolders == 0)
+		{
+			int result;
+			do
+				result = ::flock(fd, LOCK_SH | LOCK_NB);
+			while (result < 0 && errno == EINTR);
+
+			if (result < 0)
+			{
+				mutex.unlock_shared();
+				if (errno == EWOULDBLOCK)
+					return false;
+				throwErrno("flock");
+			}
+		}
+		++sharedHolders;
+		return true;
+	}
+
+	namespace
+	{
+		// EINTR is retried, returns false only when a non-blocking request conflicts
+		bool rangeLock(int fd, int command, short type, off_t offset, off_t bytes)
+		{
+			struct flock range = {};
+			range.l_type = type;
+			range.l_whence = SEEK_SET;
+			range.l_start = offset;
+			range.l_len = bytes;
+
+			int result;
+			do
+				result = ::fcntl(fd, command, &range);
+			while (result < 0 && errno == EINTR);
+
+			if (result < 0)
+			{
+				if (command == F_OFD_SETLK && (errno == EAGAIN || errno == EACCES))
+					return false;
+				throwErrno("fcntl");
+			}
+			return true;
+		}
+	} // namespace
+
+	void File::lockRange(off_t offset, off_t bytes, bool shared)
+	{
+		rangeLock(fd, F_OFD_SETLKW, shared ? F_RDLCK : F_WRLCK, offset, bytes);
+	}
+
+	bool File::tryLockRange(off_t offset, off_t bytes, bool shared)
+	{
+		return rangeLock(fd, F_OFD_SETLK, shared ? F_RDLCK : F_WRLCK, offset, bytes);
+	}
+
+	void File::unlockRange(off_t offset, off_t bytes)
+	{
+		// Writes to the range have to be out before another process can take it
+		flush();
+		rangeLock(fd, F_OFD_SETLK, F_UNLCK, offset, bytes);
+	}
+} // namespace Gerk
@@ -1,14 +1,125 @@
 #ifndef INCLUDE_GERK_FILE
 #define INCLUDE_GERK_FILE
 
+#include "delimiterScanner.h"
+#include "directory.h"
+#include "flags.h"
+#include "stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <span>
+#include <initializer_list>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 
 namespace Gerk
 {
+	class LineIndex;
+
+	// Record framings for File::readRecord(), each says how long the record at the front of the read buffer is
+	//
+	// frame() returns false while the bytes so far don't say yet, otherwise sets how many header bytes to skip and how many body bytes follow
+	namespace Framing
+	{
+		// Records end at the File's delimiter, same as readLineView()
+		struct Delimited
+		{
+		};
+
+		// Every record is exactly Bytes long
+		template <size_t Bytes>
+		struct Fixed
+		{
+			static bool frame(const char *, size_t, size_t &header, size_t &body)
+			{
+				header = 0;
+				body = Bytes;
+				return true;
+			}
+		};
+
+		// 32 bit little endian length before every record
+		struct LengthPrefixed
+		{
+			static bool frame(const char *data, size_t available, size_t &header, size_t &body)
+			{
+				if (available < 4)
+					return false;
+				const unsigned char *bytes = (const unsigned char *)data;
+				header = 4;
+				body = (size_t)bytes[0] | (size_t)bytes[1] << 8 | (size_t)bytes[2] << 16 | (size_t)bytes[3] << 24;
+				return true;
+			}
+		};
+
+		// Protocol buffers style base 128 varint length before every record
+		struct Varint
+		{
+			static bool frame(const char *data, size_t available, size_t &header, size_t &body);
+		};
+	} // namespace Framing
+
+	// Input range over the readLineView() of a File or MappedFile
+	template <typename Source>
+	class LineRange
+	{
+		Source &source;
+
+	public:
+		class iterator
+		{
+			Source *source;
+			std::optional<std::string_view> current;
+
+		public:
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() : source(nullptr) {}
+			explicit iterator(Source &source) : source(&source), current(source.readLineView()) {}
+
+			std::string_view operator*() const { return *current; }
+			const std::string_view *operator->() const { return &*current; }
+			iterator &operator++()
+			{
+				current = source->readLineView();
+				return *this;
+			}
+			void operator++(int) { ++*this; }
+			bool operator==(std::default_sentinel_t) const { return !current; }
+		};
+
+		explicit LineRange(Source &source) : source(source) {}
+		iterator begin() { return iterator(source); }
+		std::default_sentinel_t end() { return std::default_sentinel; }
+	};
+
+	namespace detail
+	{
+		// Buffer memory goes back to the memory_resource it came from, whatever the File uses by then
+		struct BufferDeleter
+		{
+			std::pmr::memory_resource *resource = nullptr;
+			size_t bytes = 0;
+
+			void operator()(char *buffer) const { resource->deallocate(buffer, bytes); }
+		};
+	} // namespace detail
+
 	class File
 	{
 	public:
@@ -405,22 +516,421 @@ namespace Gerk
 			Sticky = S_ISVTX,
 		};
 
+		// Which of reading and writing the file descriptor allows, OpenMode can't express it since O_RDONLY is 0
+		enum class Access : int
+		{
+			ReadOnly = O_RDONLY,
+			WriteOnly = O_WRONLY,
+			ReadWrite = O_RDWR,
+		};
+
+		// What posix_fadvise(2) is told to expect of a range
+		enum class Advice : int
+		{
+			/*
+			Indicates that the application has no advice to give about its access pattern for the
+			specified data.  If no advice is given for an open file, this is the default assumption.
+			*/
+			Normal = POSIX_FADV_NORMAL,
+
+			/*
+			The application expects to access the specified data sequentially (with lower offsets
+			read before higher ones).
+			*/
+			Sequential = POSIX_FADV_SEQUENTIAL,
+
+			/*
+			The specified data will be accessed in random order.
+			*/
+			Random = POSIX_FADV_RANDOM,
+
+			/*
+			The specified data will be accessed only once.
+			*/
+			NoReuse = POSIX_FADV_NOREUSE,
+
+			/*
+			The specified data will be accessed in the near future.
+			*/
+			WillNeed = POSIX_FADV_WILLNEED,
+
+			/*
+			The specified data will not be accessed in the near future.
+			*/
+			DontNeed = POSIX_FADV_DONTNEED,
+		};
+
+		// Per call flags for the positional vectored read() and write(), see preadv2(2)
+		enum class IoFlags : int
+		{
+			None = 0,
+
+			/*
+			High  priority  read/write.   Allows block-based filesystems to
+			use polling of the device, which provides lower latency, but may
+			use additional resources.  (Currently, this feature  is  usable
+			only  on  a  file  descriptor opened using the O_DIRECT flag.)
+			*/
+			HighPriority = RWF_HIPRI,
+
+			/*
+			Provide a per-write equivalent of the O_DSYNC open(2) flag.  This
+			flag is meaningful only for pwritev2(), and its effect applies
+			only to the data range written by the system call.
+			*/
+			Dsync = RWF_DSYNC,
+
+			/*
+			Provide a per-write equivalent of the O_SYNC open(2) flag.  This
+			flag is meaningful only for pwritev2(), and its effect applies
+			only to the data range written by the system call.
+			*/
+			Synchronous = RWF_SYNC,
+
+			/*
+			Do not wait for data which is not immediately available.  If
+			this flag is specified, the preadv2() system call will return
+			instantly if it would have to read data from the backing storage
+			or wait for a lock.  If some data was successfully read, it will
+			return the number of bytes read.  If no bytes were read, it will
+			return -1 and set errno to EAGAIN.
+			*/
+			NoWait = RWF_NOWAIT,
+
+			/*
+			Provide a per-write equivalent of the O_APPEND open(2) flag.  This
+			flag is meaningful only for pwritev2(), and its effect applies
+			only to the data range written by the system call.  The offset
+			argument does not affect the write operation; the data is always
+			appended to the end of the file.
+			*/
+			Append = RWF_APPEND,
+		};
+
+		// Alignment O_DIRECT transfers need for buffer addresses and for file offsets and lengths
+		struct DirectAlignment
+		{
+			size_t memory = 0;
+			size_t offset = 0;
+		};
+
+		// Size of the read-ahead buffer used by readLine() unless another is requested
+		static constexpr size_t DefaultReadBufferSize = 64 * 1024;
+
 	private:
+		using Buffer = std::unique_ptr<char[], detail::BufferDeleter>;
+
 		int fd;
 
+		// Where the read and write buffers are allocated from
+		std::pmr::memory_resource *resource = std::pmr::get_default_resource();
+
+		// Read-ahead buffer, bytes in [readBegin, readEnd) have been read from fd but not yet consumed
+		Buffer readBuffer;
+		size_t readBufferCapacity = 0;
+		size_t readBufferSize;
+		size_t readBegin = 0;
+		size_t readEnd = 0;
+		// The last refill found a non-blocking descriptor empty, see wouldBlock()
+		bool blocked = false;
+		// lseek(2) failed with ESPIPE once, so read-ahead is never given back
+		bool unseekable = false;
+
+		// What readLine() splits on, with the block it last scanned in the read buffer
+		DelimiterScanner delimiter;
+		DelimiterScanner::State scanState;
+
+		// Write coalescing buffer, disabled while writeBufferSize is 0
+		Buffer writeBuffer;
+		size_t writeBufferSize = 0;
+		size_t writeBufferUsed = 0;
+		size_t writeHighWaterMark = 0;
+
+		// Auto-extended preallocation, disabled while preallocationStep is 0
+		size_t preallocationStep = 0;
+		off_t preallocatedEnd = 0;
+
+		// Non-zero only when opened with OpenMode::Direct
+		DirectAlignment alignment;
+		// Keeps writeDirect() from trimming a padded tail block off a file another thread's write just extended
+		mutable std::shared_mutex directSizeMutex;
+
+		std::shared_mutex mutex;
+		// Shared holders in this process share one flock(2), the first takes it and the last drops it
+		std::mutex sharedFlockMutex;
+		size_t sharedHolders = 0;
+
+		// read(2) at the file offset, through readDirect() under O_DIRECT
+		size_t readSome(char *buffer, size_t bytes);
+		// Bounce unaligned O_DIRECT transfers through an aligned buffer, reading around a partly written head and tail block first
+		// Neighbouring writes to the same block from other threads can race with that read-modify-write
+		size_t readDirect(off_t offset, char *buffer, size_t bytes) const;
+		void writeDirect(off_t offset, const char *data, size_t bytes) const;
+
+		// Refills the read buffer with a single read(2), returns false at end of file
+		// Unconsumed bytes are moved to the front of the buffer, which grows if they already fill it
+		bool fillReadBuffer();
+		// Refills until at least bytes are buffered, false if the file ends first
+		bool ensureReadable(size_t bytes);
+		[[noreturn]] static void throwTruncatedRecord();
+		// readLineView(), with takePartial false a last line without its delimiter is left in the buffer
+		std::optional<std::string_view> nextLine(bool takePartial);
+		// readAllInto() for either string type
+		template <typename String>
+		void readRemaining(String &out);
+		// Seeks back over any unconsumed read-ahead so the file offset matches what the caller has seen
+		// On a descriptor that can't seek the read-ahead is kept for the next read instead
+		void discardReadAhead();
+		// discardReadAhead() without throwing, false with errno set
+		bool rewindReadAhead() noexcept;
+		// Grows the preallocation ahead of a write of bytes at the file offset once it comes within half a step of its end
+		void extendPreallocation(size_t bytes);
+		// One read(2) or write(2) with EINTR retried and counted in the stats, -1 with errno set on failure
+		ssize_t readOnce(char *buffer, size_t bytes) noexcept;
+		ssize_t writeOnce(const char *data, size_t bytes) noexcept;
+		// flush() without throwing, whatever a failed or short write(2) left stays in the write buffer
+		std::error_code drainWriteBuffer() noexcept;
+		// Issues write(2) until every byte is written
+		void writeAll(const char *data, size_t bytes);
+		// Issues writev(2) until every buffer is written
+		void writeAll(std::span<const iovec> buffers);
+
+		// Where createAnonymous() made the file, until publish() gives it a name
+		struct Unpublished;
+		std::unique_ptr<Unpublished> unpublished;
+
+		// Takes no space at all unless built with GERK_FILE_STATS
+		[[no_unique_address]] detail::StatsHandle statsHandle;
+
+		Buffer allocateBuffer(size_t bytes) const { return Buffer((char *)resource->allocate(bytes), detail::BufferDeleter{resource, bytes}); }
+
+		// Takes ownership of an fd just opened with flags
+		File(int fd, OpenMode flags, size_t readBufferSize);
+
 	public:
-		File(const std::string &path, OpenMode flags, Permissions mode = (Permissions)0);
+		// Failed system calls throw std::system_error carrying their errno, see open() and the try* calls for the non-throwing API
+
+		// Opens read/write where permissions allow it and read only otherwise
+		File(const char *path, OpenMode flags, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize);
+		File(const std::string &path, OpenMode flags, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize)
+			: File(path.c_str(), flags, mode, readBufferSize) {}
+		File(std::string_view path, OpenMode flags, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize)
+			: File(detail::CString(path).c_str(), flags, mode, readBufferSize) {}
+		// Opens with exactly the given access mode
+		File(const char *path, Access access, OpenMode flags = (OpenMode)0, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize);
+		File(const std::string &path, Access access, OpenMode flags = (OpenMode)0, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize)
+			: File(path.c_str(), access, flags, mode, readBufferSize) {}
+		File(std::string_view path, Access access, OpenMode flags = (OpenMode)0, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize)
+			: File(detail::CString(path).c_str(), access, flags, mode, readBufferSize) {}
+		// name resolved relative to directory with openat2(2), so only the last components are walked
+		File(const Directory &directory, std::string_view name, OpenMode flags, Permissions mode = (Permissions)0, Directory::Resolve resolve = Directory::Resolve::None, size_t readBufferSize = DefaultReadBufferSize);
+		File(const Directory &directory, std::string_view name, Access access, OpenMode flags = (OpenMode)0, Permissions mode = (Permissions)0, Directory::Resolve resolve = Directory::Resolve::None, size_t readBufferSize = DefaultReadBufferSize);
 		File(File &&other);
 		~File();
 
+		// Same opens without exceptions, for callers that treat failing to open as an ordinary outcome
+		// Nothing allocates unless the path is longer than 255 bytes
+		static std::expected<File, std::error_code> open(const char *path, OpenMode flags, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize) noexcept;
+		static std::expected<File, std::error_code> open(const char *path, Access access, OpenMode flags = (OpenMode)0, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize) noexcept;
+		static std::expected<File, std::error_code> open(std::string_view path, OpenMode flags, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize) noexcept;
+		static std::expected<File, std::error_code> open(std::string_view path, Access access, OpenMode flags = (OpenMode)0, Permissions mode = (Permissions)0, size_t readBufferSize = DefaultReadBufferSize) noexcept;
+
+		// The underlying file descriptor, still owned by this File
+		int descriptor() const { return fd; }
+		// Read-ahead not consumed yet, what the next reads return before going to the descriptor again
+		size_t buffered() const { return readEnd - readBegin; }
+		// Flushes and gives up ownership of the file descriptor, leaving this File closed
+		int release();
+
+		// A new read/write file in directory with no name yet, so no one sees it half written, see publish()
+		// Uses O_TMPFILE, or a hidden randomly named file on filesystems without it that is removed if the File is never published
+		static File createAnonymous(const Directory &directory, Permissions mode = (Permissions)(S_IRUSR | S_IWUSR));
+		static File createAnonymous(std::string_view directory, Permissions mode = (Permissions)(S_IRUSR | S_IWUSR));
+		// Flushes and atomically gives a file from createAnonymous() the name, relative to its directory
+		// With replace an existing file of that name is swapped out in one step, without it std::errc::file_exists is thrown
+		// Readers see either the old file or all of the new one, call sync() first for that to hold across a crash too
+		File &publish(std::string_view name, bool replace = true);
+
+		// Counts this File's I/O from now on, on top of the per-thread counters every File feeds
+		// Does nothing unless the library is built with GERK_FILE_STATS, where the counters are compiled out altogether
+		void enableStats() { statsHandle.enable(); }
+		// What this File has done since enableStats(), all zero if it was never called
+		IoStats stats() const { return statsHandle.snapshot(); }
+		// Every File in the process, summed over the threads that did it
+		static IoStats globalStats() { return detail::globalStats(); }
+		static void resetGlobalStats() { detail::resetGlobalStats(); }
+
+		// Flushes, drops the read-ahead and moves the file offset as lseek(2) does, returns the new offset
+		off_t seek(off_t offset, int whence = SEEK_SET);
+		// Moves to the start of line n (from 0) with a lookup in index and a scan over at most its stride of lines
+		// index has to be of this file with this File's delimiter, false and at end of file when there are only index.lines() lines
+		bool seekLine(const LineIndex &index, uint64_t line);
+
+		// Alignment found through statx(2) STATX_DIOALIGN when opened with OpenMode::Direct, zero otherwise
+		// Line reads, read(), write(), readAt() and writeAt() on a Direct file honour it transparently, aligned calls go straight through without a copy
+		// The vectored read() and write() at an offset don't, their buffers, lengths and offset have to be aligned already
+		DirectAlignment directAlignment() const { return alignment; }
+
+		// Allocates the read and write buffers from resource from now on, buffers already allocated stay where they are until replaced
+		// resource has to outlive the File, or at least its buffers
+		void setMemoryResource(std::pmr::memory_resource *resource) { this->resource = resource ? resource : std::pmr::get_default_resource(); }
+		std::pmr::memory_resource *memoryResource() const { return resource; }
+
+		// Takes effect on the next refill, any buffered data is kept
+		void setReadBufferSize(size_t bytes);
+		// Lines end at delimiter instead of '\n', "\r\n" or std::string_view("\0", 1) for instance
+		void setDelimiter(std::string_view delimiter);
+		const DelimiterScanner &lineDelimiter() const { return delimiter; }
+
+		// Next line without its delimiter, the last line of the file doesn't need one
 		std::optional<std::string> readLine();
+		// Next line into out, reusing its capacity and allocator, false at end of file
+		// A std::pmr::string on a std::pmr::monotonic_buffer_resource lets a whole batch of lines be freed at once
+		bool readLine(std::string &out);
+		bool readLine(std::pmr::string &out);
+		// Like readLine() but points into the read buffer, only valid until the next read from this file
+		std::optional<std::string_view> readLineView();
+		// Like readLineView() but a last line without its delimiter stays buffered and std::nullopt is returned,
+		// so a file still being appended to can be tried again once the rest of the line is written
+		std::optional<std::string_view> readCompleteLineView();
+
+		// Everything from the file offset to the end of the file, starting with any read-ahead
+		// Sized from one statx(2), so a regular file costs a single allocation and a single read(2)
+		// Files that report a size of 0, /proc and pipes for instance, are read into a buffer that grows instead
+		std::string readAll();
+		// Same into out, replacing what it held and reusing its capacity and allocator
+		std::string &readAllInto(std::string &out);
+		std::pmr::string &readAllInto(std::pmr::string &out);
+
+		// On a non-blocking descriptor readLineView() and readRecord() return std::nullopt once it has nothing more for now,
+		// keeping a partial line or record buffered; this tells that apart from end of file until the next refill
+		bool wouldBlock() const { return blocked; }
+
+		// Range over readLineView(), for (std::string_view line : file.lines())
+		using Lines = LineRange<File>;
+		Lines lines() { return Lines(*this); }
+
+		// Next record of a binary or delimited stream, the framing is a policy type from Framing so the loop is resolved at compile time
+		// Like readLineView() the view points into the read buffer and is valid until the next read, std::nullopt at a clean end of file
+		// A record cut off by the end of the file is thrown as std::system_error with std::errc::illegal_byte_sequence
+		template <typename Policy>
+		std::optional<std::string_view> readRecord()
+		{
+			if constexpr (std::is_same_v<Policy, Framing::Delimited>)
+				return readLineView();
+			else
+			{
+				size_t header, body;
+				while (!Policy::frame(readBuffer.get() + readBegin, readEnd - readBegin, header, body))
+				{
+					if (!fillReadBuffer())
+					{
+						if (readBegin == readEnd || blocked)
+							return std::nullopt;
+						throwTruncatedRecord();
+					}
+				}
+
+				if (readEnd - readBegin < header + body && !ensureReadable(header + body))
+				{
+					if (blocked || (readBegin == readEnd && !header && body))
+						return std::nullopt;
+					throwTruncatedRecord();
+				}
+
+				std::string_view record(readBuffer.get() + readBegin + header, body);
+				readBegin += header + body;
+				return record;
+			}
+		}
+
 		File &write(const std::string &data);
 		File &write(const char *const data, const size_t bytes);
 
+		// Non-throwing single system call I/O for non-blocking descriptors, pipes and sockets opened with OpenMode::NonBlocking
+		// Errors come back as the errno code, EAGAIN as std::errc::resource_unavailable_try_again, and EINTR is retried
+		// tryWrite() makes one write(2) and returns how much of data it took, which may be less than bytes
+		// Anything in the write buffer goes out first, if it can't all go the call fails without taking any of data
+		std::expected<size_t, std::error_code> tryWrite(const char *data, size_t bytes) noexcept;
+		std::expected<size_t, std::error_code> tryWrite(std::string_view data) noexcept { return tryWrite(data.data(), data.size()); }
+		// Serves read-ahead first, otherwise one read(2), 0 at end of file
+		std::expected<size_t, std::error_code> tryRead(char *buffer, size_t bytes) noexcept;
+		std::expected<size_t, std::error_code> tryRead(std::span<char> buffer) noexcept { return tryRead(buffer.data(), buffer.size()); }
+		// Drains the write buffer as far as the descriptor takes it, keeping the rest for the next call
+		std::expected<void, std::error_code> tryFlush() noexcept;
+
+		// Gathers the buffers into a single writev(2), or into the write buffer when they are small enough
+		File &write(std::span<const iovec> buffers);
+		File &write(std::initializer_list<std::string_view> buffers);
+		// Scatters what is read over the buffers, serving any read-ahead first, returns the bytes read and 0 at end of file
+		size_t read(std::span<const iovec> buffers);
+
+		// One pwritev2(2)/preadv2(2) at offset, or at the file offset when it is -1, returns the bytes transferred
+		// With IoFlags::NoWait, std::nullopt means the call would have blocked (or the kernel can't tell) and should be retried without it
+		// Passed to the kernel as they are, so on a Direct file anything not aligned to directAlignment() fails with EINVAL
+		std::optional<size_t> write(std::span<const iovec> buffers, off_t offset, IoFlags flags = IoFlags::None);
+		std::optional<size_t> read(std::span<const iovec> buffers, off_t offset, IoFlags flags = IoFlags::None);
+
+		// pread(2)/pwrite(2) at an absolute offset, leaving the file offset and both buffers alone
+		// Safe to call from many threads at once without lock(), anything still in the write buffer isn't visible to them until flush()
+		// readAt() fills the whole buffer unless it hits end of file and returns the bytes read
+		size_t readAt(off_t offset, char *const buffer, const size_t bytes) const;
+		size_t readAt(off_t offset, std::span<char> buffer) const { return readAt(offset, buffer.data(), buffer.size()); }
+		// On Linux pwrite(2) ignores the offset and appends if the file was opened with OpenMode::Append
+		const File &writeAt(off_t offset, const char *const data, const size_t bytes) const;
+		const File &writeAt(off_t offset, std::string_view data) const { return writeAt(offset, data.data(), data.size()); }
+
+		// Copies bytes [offset, offset + bytes) of this file to dst at its file offset without passing them through user space where the kernel allows it
+		// Tries a reflink (FICLONERANGE), then copy_file_range(2), then sendfile(2), then a buffered loop, returns the bytes copied
+		size_t copyTo(File &dst, off_t offset = 0, size_t bytes = SIZE_MAX);
+		// Sends bytes [offset, offset + bytes) to a socket (or pipe) with sendfile(2), falling back to splice(2) through a pipe and then a buffered loop
+		// Stops early and returns what was sent if a non-blocking socket fills up
+		size_t sendTo(int socketFd, off_t offset = 0, size_t bytes = SIZE_MAX);
+
+		// Allocates blocks for [0, bytes) with fallocate(2) FALLOC_FL_KEEP_SIZE, so writes up to there don't allocate and the size doesn't change
+		File &reserve(off_t bytes);
+		// Deallocates [offset, offset + bytes), which then reads as zeroes without changing the size
+		File &punchHole(off_t offset, off_t bytes);
+		// posix_fadvise(2) over [offset, offset + bytes), bytes = 0 runs to the end of the file
+		// DontNeed after consuming a log drops its pages from the cache, anything still in the write buffer is flushed first
+		File &advise(Advice advice, off_t offset = 0, off_t bytes = 0);
+		// Keeps at least step / 2 bytes preallocated past the file offset, extending by step bytes whenever a flushed write gets closer
+		// Best effort, a filesystem without fallocate(2) just allocates as it writes; step = 0 turns it off
+		void setPreallocation(size_t step);
+
+		// Packs small writes into one buffer drained by flush(), unlock(), the destructor or when full
+		// Writes of at least highWaterMark bytes skip the buffer, 0 uses the buffer size; bytes = 0 disables buffering
+		void setWriteBufferSize(size_t bytes, size_t highWaterMark = 0);
+		// Writes out anything held in the write buffer
+		File &flush();
+		// flush() then fsync(2), or fdatasync(2) when dataOnly is set
+		File &sync(bool dataOnly = false);
+
 		// Can be used as mutex for with std::lock_gaurd<mutex> and the like
 		void lock();
 		void unlock();
+		bool try_lock();
+
+		// Shared side of the lock, in the std::shared_mutex shape so std::shared_lock works
+		// Readers only exclude writers, both across threads and, through flock(2), across processes
+		void lock_shared();
+		void unlock_shared();
+		bool try_lock_shared();
+
+		// Open file description locks (F_OFD_SETLKW) on [offset, offset + bytes), bytes = 0 runs to the end of the file however it grows
+		// They exclude other Files and other processes, threads sharing this File all own the same locks so need a File each to exclude one another
+		void lockRange(off_t offset, off_t bytes, bool shared = false);
+		bool tryLockRange(off_t offset, off_t bytes, bool shared = false);
+		void unlockRange(off_t offset, off_t bytes);
 	};
+
+	// OpenMode, Permissions and IoFlags combine with the operators in flags.h, File::OpenMode::Create | File::OpenMode::Truncate
+	template <>
+	inline constexpr bool IsFlagSet<File::OpenMode> = true;
+	template <>
+	inline constexpr bool IsFlagSet<File::Permissions> = true;
+	template <>
+	inline constexpr bool IsFlagSet<File::IoFlags> = true;
 } // namespace Gerk
 
 #endif // INCLUDE_GERK_FILE
\ No newline at end of file
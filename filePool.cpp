@@ -0,0 +1,250 @@
+#include "filePool.h"
+
+#include <functional>
+#include <system_error>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		size_t defaultCapacity()
+		{
+			rlimit limit;
+			if (::getrlimit(RLIMIT_NOFILE, &limit) < 0)
+				throwErrno("getrlimit");
+			// Half leaves the rest of the process descriptors of its own
+			if (limit.rlim_cur == RLIM_INFINITY)
+				return 4096;
+			return limit.rlim_cur / 2;
+		}
+	} // namespace
+
+	size_t FilePool::KeyHash::operator()(const Key &key) const
+	{
+		size_t hash = std::hash<std::string>()(key.path);
+		hash ^= std::hash<int>()(key.flags) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<int>()(key.access) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+	FilePool::FilePool(Options options)
+		: options(options), shards(options.shards ? options.shards : 1)
+	{
+		size_t capacity = options.capacity ? options.capacity : defaultCapacity();
+		shardCapacity = capacity / shards.size();
+		if (!shardCapacity)
+			shardCapacity = 1;
+	}
+
+	FilePool::Shard &FilePool::shardFor(const std::string &path)
+	{
+		// By path alone, so invalidate() finds every set of flags a path was opened with in one shard
+		return shards[std::hash<std::string>()(path) % shards.size()];
+	}
+
+	void FilePool::trim(Shard &shard, std::vector<std::unique_ptr<Entry>> &evicted)
+	{
+		while (shard.open > shardCapacity && !shard.idle.empty())
+		{
+			auto last = std::prev(shard.idle.end());
+			auto [begin, end] = shard.index.equal_range((*last)->key);
+			for (auto it = begin; it != end; ++it)
+			{
+				if (it->second == last)
+				{
+					shard.index.erase(it);
+					break;
+				}
+			}
+			evicted.push_back(std::move(*last));
+			shard.idle.erase(last);
+			shard.open--;
+		}
+	}
+
+	std::unique_ptr<FilePool::Entry> FilePool::take(Key key, mode_t mode)
+	{
+		Shard &shard = shardFor(key.path);
+		std::unique_ptr<Entry> entry;
+		std::vector<std::unique_ptr<Entry>> evicted;
+		{
+			std::lock_guard<std::mutex> guard(shard.mutex);
+			auto found = shard.index.find(key);
+			if (found != shard.index.end())
+			{
+				entry = std::move(*found->second);
+				shard.idle.erase(found->second);
+				shard.index.erase(found);
+				shard.leased.insert(entry.get());
+			}
+			else
+			{
+				// Counted before opening so racing acquires can't overshoot the capacity by more than what is leased
+				shard.open++;
+				trim(shard, evicted);
+			}
+		}
+		// Closed without holding the shard
+		evicted.clear();
+
+		if (entry && options.revalidate)
+		{
+			struct stat status;
+			// Renamed over, deleted or recreated, the reopened File takes over its slot
+			if (::stat(key.path.c_str(), &status) < 0 || status.st_dev != entry->device || status.st_ino != entry->inode)
+			{
+				{
+					std::lock_guard<std::mutex> guard(shard.mutex);
+					shard.leased.erase(entry.get());
+				}
+				entry.reset();
+			}
+		}
+
+		if (entry)
+			return entry;
+
+		try
+		{
+			File file = key.access < 0 ? File(key.path, (File::OpenMode)key.flags, (File::Permissions)mode) : File(key.path, (File::Access)key.access, (File::OpenMode)key.flags, (File::Permissions)mode);
+			struct stat status;
+			if (::fstat(file.descriptor(), &status) < 0)
+				throwErrno("fstat");
+			entry.reset(new Entry{std::move(key), std::move(file), status.st_dev, status.st_ino});
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> guard(shard.mutex);
+			shard.open--;
+			throw;
+		}
+
+		std::lock_guard<std::mutex> guard(shard.mutex);
+		shard.leased.insert(entry.get());
+		return entry;
+	}
+
+	void FilePool::giveBack(std::unique_ptr<Entry> entry, bool keep)
+	{
+		Shard &shard = shardFor(entry->key.path);
+		std::vector<std::unique_ptr<Entry>> evicted;
+		{
+			std::lock_guard<std::mutex> guard(shard.mutex);
+			shard.leased.erase(entry.get());
+			if (keep && !entry->stale && shard.open <= shardCapacity)
+			{
+				shard.idle.push_front(std::move(entry));
+				shard.index.emplace(shard.idle.front()->key, shard.idle.begin());
+			}
+			else
+				shard.open--;
+			trim(shard, evicted);
+		}
+	}
+
+	FilePool::Lease &FilePool::Lease::operator=(Lease &&other)
+	{
+		if (this != &other)
+		{
+			release();
+			pool = other.pool;
+			entry = std::move(other.entry);
+		}
+		return *this;
+	}
+
+	FilePool::Lease::~Lease()
+	{
+		release();
+	}
+
+	void FilePool::Lease::release()
+	{
+		if (!entry)
+			return;
+
+		bool keep = true;
+		try
+		{
+			// The next lease starts where a fresh open(2) would
+			entry->file.seek(0);
+		}
+		catch (const std::system_error &)
+		{
+			keep = false;
+		}
+		pool->giveBack(std::move(entry), keep);
+	}
+
+	void FilePool::Lease::discard()
+	{
+		if (entry)
+			pool->giveBack(std::move(entry), false);
+	}
+
+	FilePool::Lease FilePool::acquire(const std::string &path, File::OpenMode flags, File::Permissions mode)
+	{
+		return Lease(*this, take(Key{path, (int)flags, -1}, (mode_t)mode));
+	}
+
+	FilePool::Lease FilePool::acquire(const std::string &path, File::Access access, File::OpenMode flags, File::Permissions mode)
+	{
+		return Lease(*this, take(Key{path, (int)flags, (int)access}, (mode_t)mode));
+	}
+
+	void FilePool::invalidate(const std::string &path)
+	{
+		Shard &shard = shardFor(path);
+		std::vector<std::unique_ptr<Entry>> evicted;
+		{
+			std::lock_guard<std::mutex> guard(shard.mutex);
+			for (auto it = shard.index.begin(); it != shard.index.end();)
+			{
+				if (it->first.path == path)
+				{
+					evicted.push_back(std::move(*it->second));
+					shard.idle.erase(it->second);
+					it = shard.index.erase(it);
+					shard.open--;
+				}
+				else
+					++it;
+			}
+			for (Entry *entry : shard.leased)
+			{
+				if (entry->key.path == path)
+					entry->stale = true;
+			}
+		}
+	}
+
+	void FilePool::clear()
+	{
+		for (Shard &shard : shards)
+		{
+			std::list<std::unique_ptr<Entry>> evicted;
+			std::lock_guard<std::mutex> guard(shard.mutex);
+			shard.open -= shard.idle.size();
+			shard.index.clear();
+			evicted.swap(shard.idle);
+		}
+	}
+
+	size_t FilePool::size()
+	{
+		size_t open = 0;
+		for (Shard &shard : shards)
+		{
+			std::lock_guard<std::mutex> guard(shard.mutex);
+			open += shard.open;
+		}
+		return open;
+	}
+} // namespace Gerk
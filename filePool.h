@@ -0,0 +1,140 @@
+#ifndef INCLUDE_GERK_FILE_POOL
+#define INCLUDE_GERK_FILE_POOL
+
+#include "file.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/types.h>
+
+namespace Gerk
+{
+	// Keeps recently used Files open so opening the same paths again skips open(2)
+	//
+	// acquire() hands out a lease on a File no one else holds, reusing an idle one opened with the same path and flags
+	// when there is one; the lease puts it back, flushed and rewound, when it goes away
+	// Idle Files are closed least recently used first once the pool holds more than its capacity
+	// Paths are split over independently locked shards so threads acquiring different files rarely contend
+	class FilePool
+	{
+	public:
+		struct Options
+		{
+			// Most Files kept open at once, 0 is half of the RLIMIT_NOFILE soft limit
+			// Leases are never refused, Files beyond the capacity are closed when their lease ends instead
+			size_t capacity = 0;
+
+			// Independently locked parts of the pool, each holding an equal share of the capacity
+			unsigned shards = 16;
+
+			// stat(2) the path before reusing an idle File and reopen it if the path now names another inode,
+			// after a rename(2) over it or a delete and recreate; without it reuse is a lookup and nothing more
+			bool revalidate = true;
+		};
+
+	private:
+		struct Key
+		{
+			std::string path;
+			int flags;
+			// -1 when opened by File's read/write, falling back to read only, constructor
+			int access;
+
+			bool operator==(const Key &) const = default;
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key &key) const;
+		};
+
+		struct Entry
+		{
+			Key key;
+			File file;
+			dev_t device;
+			ino_t inode;
+			// Set by invalidate() while leased, so the lease closes it instead of giving it back
+			bool stale = false;
+		};
+
+		struct Shard
+		{
+			std::mutex mutex;
+			// Most recently returned at the front
+			std::list<std::unique_ptr<Entry>> idle;
+			std::unordered_multimap<Key, std::list<std::unique_ptr<Entry>>::iterator, KeyHash> index;
+			std::unordered_set<Entry *> leased;
+			// Idle and leased Files belonging to this shard
+			size_t open = 0;
+		};
+
+		Options options;
+		size_t shardCapacity;
+		std::vector<Shard> shards;
+
+		Shard &shardFor(const std::string &path);
+		// Takes out the most recently used idle entry for key, or opens a new one
+		std::unique_ptr<Entry> take(Key key, mode_t mode);
+		// Back to the idle list when keep is set and the entry isn't stale, closed otherwise
+		void giveBack(std::unique_ptr<Entry> entry, bool keep);
+		// Removes idle entries from the back until the shard is within capacity, the caller closes them after unlocking
+		void trim(Shard &shard, std::vector<std::unique_ptr<Entry>> &evicted);
+
+	public:
+		// Exclusive use of a pooled File until destroyed
+		class Lease
+		{
+			friend class FilePool;
+
+			FilePool *pool = nullptr;
+			std::unique_ptr<Entry> entry;
+
+			Lease(FilePool &pool, std::unique_ptr<Entry> entry) : pool(&pool), entry(std::move(entry)) {}
+			// Flushes, rewinds and hands the File back, or closes it if that fails
+			void release();
+
+		public:
+			Lease() = default;
+			Lease(Lease &&other) = default;
+			Lease &operator=(Lease &&other);
+			// Returns the File to the pool, or closes it if it can't be flushed and rewound
+			~Lease();
+
+			File &operator*() const { return entry->file; }
+			File *operator->() const { return &entry->file; }
+			File &get() const { return entry->file; }
+			explicit operator bool() const { return (bool)entry; }
+
+			// Closes the File now instead of returning it, for one left in a state no one else should inherit
+			void discard();
+		};
+
+		explicit FilePool(Options options);
+		FilePool() : FilePool(Options()) {}
+
+		FilePool(const FilePool &) = delete;
+		FilePool &operator=(const FilePool &) = delete;
+
+		// Flags and permissions only matter when the file is actually opened, Truncate and Exclusive don't apply to an idle File being reused
+		Lease acquire(const std::string &path, File::OpenMode flags = (File::OpenMode)0, File::Permissions mode = (File::Permissions)0);
+		Lease acquire(const std::string &path, File::Access access, File::OpenMode flags = (File::OpenMode)0, File::Permissions mode = (File::Permissions)0);
+
+		// Closes the idle Files open on path, leased ones are closed when their lease ends
+		void invalidate(const std::string &path);
+		// Closes every idle File
+		void clear();
+
+		// Files open through the pool right now, idle and leased
+		size_t size();
+		size_t capacity() const { return shardCapacity * shards.size(); }
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_FILE_POOL
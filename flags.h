@@ -0,0 +1,56 @@
+#ifndef INCLUDE_GERK_FLAGS
+#define INCLUDE_GERK_FLAGS
+
+#include <type_traits>
+
+namespace Gerk
+{
+	// Opts an enum class of bit flags into the bitwise operators below, specialise it to true next to the enum
+	template <typename Flags>
+	inline constexpr bool IsFlagSet = false;
+
+	template <typename Flags>
+		requires IsFlagSet<Flags>
+	constexpr Flags operator|(Flags left, Flags right)
+	{
+		return (Flags)((std::underlying_type_t<Flags>)left | (std::underlying_type_t<Flags>)right);
+	}
+
+	template <typename Flags>
+		requires IsFlagSet<Flags>
+	constexpr Flags operator&(Flags left, Flags right)
+	{
+		return (Flags)((std::underlying_type_t<Flags>)left & (std::underlying_type_t<Flags>)right);
+	}
+
+	template <typename Flags>
+		requires IsFlagSet<Flags>
+	constexpr Flags operator~(Flags flags)
+	{
+		return (Flags)~(std::underlying_type_t<Flags>)flags;
+	}
+
+	template <typename Flags>
+		requires IsFlagSet<Flags>
+	constexpr Flags &operator|=(Flags &left, Flags right)
+	{
+		return left = left | right;
+	}
+
+	template <typename Flags>
+		requires IsFlagSet<Flags>
+	constexpr Flags &operator&=(Flags &left, Flags right)
+	{
+		return left = left & right;
+	}
+
+	// Whether every flag in wanted is set
+	template <typename Flags>
+		requires IsFlagSet<Flags>
+	constexpr bool hasFlags(Flags flags, Flags wanted)
+	{
+		return (flags & wanted) == wanted;
+	}
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_FLAGS
@@ -0,0 +1,98 @@
+#include "groupCommit.h"
+
+namespace Gerk
+{
+	GroupCommit::GroupCommit(File &file, Options options)
+		: file(file), options(options), committer(&GroupCommit::run, this)
+	{
+	}
+
+	GroupCommit::~GroupCommit()
+	{
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		work.notify_one();
+		committer.join();
+	}
+
+	GroupCommit::Ticket GroupCommit::append(std::string_view data)
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		bool first = batch.empty();
+		if (first)
+			batchStarted = std::chrono::steady_clock::now();
+
+		batch.append(data);
+		Ticket ticket = ++appended;
+		bool full = batch.size() >= options.maxBytes;
+		guard.unlock();
+
+		if (first || full)
+			work.notify_one();
+		return ticket;
+	}
+
+	void GroupCommit::wait(Ticket ticket)
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		durable.wait(guard, [&]
+					 { return committed >= ticket || (failedFrom && ticket >= failedFrom); });
+		if (failedFrom && ticket >= failedFrom)
+			std::rethrow_exception(failure);
+	}
+
+	bool GroupCommit::isDurable(Ticket ticket)
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		return committed >= ticket;
+	}
+
+	void GroupCommit::run()
+	{
+		std::string writing;
+		std::unique_lock<std::mutex> guard(mutex);
+		while (true)
+		{
+			work.wait(guard, [this]
+					  { return stopping || !batch.empty(); });
+			if (batch.empty())
+				return;
+
+			// Give other writers until the deadline to join the batch, unless it is already big enough
+			auto deadline = batchStarted + options.maxLatency;
+			work.wait_until(guard, deadline, [this]
+							{ return stopping || batch.size() >= options.maxBytes; });
+
+			writing.swap(batch);
+			Ticket last = appended;
+			guard.unlock();
+
+			std::exception_ptr error;
+			if (!failure)
+			{
+				try
+				{
+					file.write(writing.data(), writing.size());
+					file.sync(options.dataOnly);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+			}
+			writing.clear();
+
+			guard.lock();
+			if (error)
+			{
+				failure = error;
+				failedFrom = committed + 1;
+			}
+			else if (!failure)
+				committed = last;
+			durable.notify_all();
+		}
+	}
+} // namespace Gerk
@@ -0,0 +1,82 @@
+#ifndef INCLUDE_GERK_GROUP_COMMIT
+#define INCLUDE_GERK_GROUP_COMMIT
+
+#include "file.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace Gerk
+{
+	// Durable appends without an fsync per write, an alternative to OpenMode::Synchronous and OpenMode::Dsync
+	//
+	// Writers from any thread append to a shared batch and get a ticket back, a committer thread writes the batch
+	// and covers all of it with a single fdatasync(2) (or fsync(2)), then wakes everyone waiting on a ticket in it
+	class GroupCommit
+	{
+	public:
+		using Ticket = uint64_t;
+
+		struct Options
+		{
+			// Longest a batch waits for company after its first append before it is committed
+			std::chrono::microseconds maxLatency = std::chrono::microseconds(1000);
+
+			// A batch this large is committed straight away
+			size_t maxBytes = 1 << 20;
+
+			// fdatasync(2) rather than fsync(2), skips metadata that isn't needed to read the data back
+			bool dataOnly = true;
+		};
+
+	private:
+		File &file;
+		Options options;
+
+		std::mutex mutex;
+		// Wakes the committer when there is work or an early commit is wanted
+		std::condition_variable work;
+		// Wakes writers when a batch becomes durable
+		std::condition_variable durable;
+
+		std::string batch;
+		std::chrono::steady_clock::time_point batchStarted;
+		Ticket appended = 0;
+		Ticket committed = 0;
+		// After a failed write or sync every later ticket fails too, the log can't be trusted past it
+		Ticket failedFrom = 0;
+		std::exception_ptr failure;
+		bool stopping = false;
+
+		std::thread committer;
+
+		void run();
+
+	public:
+		explicit GroupCommit(File &file, Options options);
+		explicit GroupCommit(File &file) : GroupCommit(file, Options()) {}
+		// Commits whatever is still pending
+		~GroupCommit();
+
+		GroupCommit(const GroupCommit &) = delete;
+		GroupCommit &operator=(const GroupCommit &) = delete;
+
+		// Queues data behind every earlier append, durable once wait() on the ticket returns
+		Ticket append(std::string_view data);
+		// Blocks until the ticket's batch is on the device, rethrows the error if it couldn't be made durable
+		void wait(Ticket ticket);
+		// append() then wait()
+		void write(std::string_view data) { wait(append(data)); }
+
+		// Whether wait() on the ticket would return without blocking
+		bool isDurable(Ticket ticket);
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_GROUP_COMMIT
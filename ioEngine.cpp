@@ -0,0 +1,508 @@
+#include "ioEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		// Most a single read(2) or write(2) moves on Linux (MAX_RW_COUNT), longer requests come back short there anyway
+		constexpr size_t MaxTransfer = 0x7ffff000;
+
+		int ioUringSetup(unsigned entries, io_uring_params *params)
+		{
+			return (int)::syscall(__NR_io_uring_setup, entries, params);
+		}
+
+		int ioUringEnter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags)
+		{
+			return (int)::syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0);
+		}
+
+		int ioUringRegister(int ring, unsigned opcode, const void *arg, unsigned count)
+		{
+			return (int)::syscall(__NR_io_uring_register, ring, opcode, arg, count);
+		}
+
+		// The rings are shared with the kernel, head and tail updates need acquire/release ordering
+		unsigned loadAcquire(const unsigned *value)
+		{
+			return std::atomic_ref<const unsigned>(*value).load(std::memory_order_acquire);
+		}
+
+		void storeRelease(unsigned *value, unsigned update)
+		{
+			std::atomic_ref<unsigned>(*value).store(update, std::memory_order_release);
+		}
+
+		// Every operation the engine issues, IORING_OP_READ/WRITE/CLOSE arrived in 5.6
+		constexpr int requiredOperations[] = {
+			IORING_OP_READ,
+			IORING_OP_WRITE,
+			IORING_OP_FSYNC,
+			IORING_OP_CLOSE,
+			IORING_OP_READ_FIXED,
+			IORING_OP_WRITE_FIXED,
+		};
+
+		bool probe(int ring)
+		{
+			constexpr unsigned slots = 256;
+			std::vector<char> storage(sizeof(io_uring_probe) + slots * sizeof(io_uring_probe_op));
+			auto *result = (io_uring_probe *)storage.data();
+			if (ioUringRegister(ring, IORING_REGISTER_PROBE, result, slots) < 0)
+				return false;
+
+			for (int operation : requiredOperations)
+			{
+				if (operation > result->last_op || !(result->ops[operation].flags & IO_URING_OP_SUPPORTED))
+					return false;
+			}
+			return true;
+		}
+	} // namespace
+
+	std::unique_ptr<IoEngine> IoEngine::create(unsigned entries)
+	{
+		if (IoRing::supported())
+			return std::make_unique<IoRing>(entries);
+		return std::make_unique<ThreadPoolEngine>();
+	}
+
+	void IoEngine::drain()
+	{
+		while (pending())
+			complete(true);
+	}
+
+	bool IoRing::supported()
+	{
+		static const bool result = []
+		{
+			io_uring_params params = {};
+			int ring = ioUringSetup(2, &params);
+			if (ring < 0)
+				return false;
+			bool usable = probe(ring);
+			::close(ring);
+			return usable;
+		}();
+		return result;
+	}
+
+	IoRing::IoRing(unsigned entries)
+	{
+		io_uring_params params = {};
+		ring = ioUringSetup(entries, &params);
+		if (ring < 0)
+			throwErrno("io_uring_setup");
+
+		sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (single)
+			sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+
+		auto map = [this](size_t size, off_t offset)
+		{
+			void *mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, offset);
+			if (mapping == MAP_FAILED)
+			{
+				int error = errno;
+				unmap();
+				errno = error;
+				throwErrno("mmap");
+			}
+			return mapping;
+		};
+
+		sqMapping = map(sqMappingSize, IORING_OFF_SQ_RING);
+		if (single)
+		{
+			cqMapping = sqMapping;
+			cqMappingSize = 0;
+		}
+		else
+			cqMapping = map(cqMappingSize, IORING_OFF_CQ_RING);
+		sqeMappingSize = params.sq_entries * sizeof(io_uring_sqe);
+		sqeMapping = map(sqeMappingSize, IORING_OFF_SQES);
+
+		char *sq = (char *)sqMapping;
+		sqHead = (unsigned *)(sq + params.sq_off.head);
+		sqTail = (unsigned *)(sq + params.sq_off.tail);
+		sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+		sqArray = (unsigned *)(sq + params.sq_off.array);
+		sqEntries = params.sq_entries;
+
+		char *cq = (char *)cqMapping;
+		cqHead = (unsigned *)(cq + params.cq_off.head);
+		cqTail = (unsigned *)(cq + params.cq_off.tail);
+		cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+		cqEntries = params.cq_entries;
+		cqes = cq + params.cq_off.cqes;
+	}
+
+	IoRing::~IoRing()
+	{
+		unmap();
+	}
+
+	void IoRing::unmap()
+	{
+		if (sqeMapping)
+			::munmap(sqeMapping, sqeMappingSize);
+		if (cqMapping && cqMapping != sqMapping)
+			::munmap(cqMapping, cqMappingSize);
+		if (sqMapping)
+			::munmap(sqMapping, sqMappingSize);
+		if (ring >= 0)
+			::close(ring);
+		sqeMapping = cqMapping = sqMapping = nullptr;
+		ring = -1;
+	}
+
+	void *IoRing::nextEntry()
+	{
+		// Keep in flight work below the completion ring size so the kernel never has to drop or hold back completions
+		while (inFlight + unsubmitted >= cqEntries)
+			complete(true);
+
+		unsigned tail = *sqTail;
+		while (tail - loadAcquire(sqHead) >= sqEntries)
+			submit();
+
+		unsigned index = tail & sqMask;
+		auto *entry = (io_uring_sqe *)sqeMapping + index;
+		std::memset(entry, 0, sizeof(*entry));
+		sqArray[index] = index;
+		return entry;
+	}
+
+	void *IoRing::prepare(int opcode, Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback)
+	{
+		auto *entry = (io_uring_sqe *)nextEntry();
+		entry->opcode = (uint8_t)opcode;
+		entry->fd = fd.fd;
+		if (fd.registered)
+			entry->flags |= IOSQE_FIXED_FILE;
+		entry->addr = (uint64_t)(uintptr_t)buffer;
+		// The entry only has 32 bits for the length, clamped to the same short count the system calls give
+		entry->len = (uint32_t)std::min(bytes, MaxTransfer);
+		entry->off = (uint64_t)offset;
+		entry->user_data = (uint64_t)(uintptr_t) new Callback(std::move(callback));
+		return entry;
+	}
+
+	void IoRing::push()
+	{
+		storeRelease(sqTail, *sqTail + 1);
+		++unsubmitted;
+	}
+
+	void IoRing::read(Descriptor fd, void *buffer, size_t bytes, off_t offset, Callback callback)
+	{
+		prepare(IORING_OP_READ, fd, buffer, bytes, offset, std::move(callback));
+		push();
+	}
+
+	void IoRing::write(Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback)
+	{
+		prepare(IORING_OP_WRITE, fd, buffer, bytes, offset, std::move(callback));
+		push();
+	}
+
+	void IoRing::fsync(Descriptor fd, bool dataOnly, Callback callback)
+	{
+		auto *entry = (io_uring_sqe *)prepare(IORING_OP_FSYNC, fd, nullptr, 0, 0, std::move(callback));
+		if (dataOnly)
+			entry->fsync_flags = IORING_FSYNC_DATASYNC;
+		// Requests in one batch run in any order, this one starts only once everything queued before it has finished
+		entry->flags |= IOSQE_IO_DRAIN;
+		push();
+	}
+
+	void IoRing::close(int fd, Callback callback)
+	{
+		prepare(IORING_OP_CLOSE, fd, nullptr, 0, 0, std::move(callback));
+		push();
+	}
+
+	void IoRing::readFixed(Descriptor fd, void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback)
+	{
+		auto *entry = (io_uring_sqe *)prepare(IORING_OP_READ_FIXED, fd, buffer, bytes, offset, std::move(callback));
+		entry->buf_index = (uint16_t)bufferIndex;
+		push();
+	}
+
+	void IoRing::writeFixed(Descriptor fd, const void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback)
+	{
+		auto *entry = (io_uring_sqe *)prepare(IORING_OP_WRITE_FIXED, fd, buffer, bytes, offset, std::move(callback));
+		entry->buf_index = (uint16_t)bufferIndex;
+		push();
+	}
+
+	void IoRing::registerBuffers(std::span<const iovec> buffers)
+	{
+		unregisterBuffers();
+		if (ioUringRegister(ring, IORING_REGISTER_BUFFERS, buffers.data(), (unsigned)buffers.size()) < 0)
+			throwErrno("io_uring_register");
+	}
+
+	void IoRing::unregisterBuffers()
+	{
+		// ENXIO just means nothing was registered
+		ioUringRegister(ring, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+	}
+
+	void IoRing::registerFiles(std::span<const int> fds)
+	{
+		unregisterFiles();
+		if (ioUringRegister(ring, IORING_REGISTER_FILES, fds.data(), (unsigned)fds.size()) < 0)
+			throwErrno("io_uring_register");
+	}
+
+	void IoRing::unregisterFiles()
+	{
+		ioUringRegister(ring, IORING_UNREGISTER_FILES, nullptr, 0);
+	}
+
+	unsigned IoRing::submit()
+	{
+		unsigned total = 0;
+		while (unsubmitted)
+		{
+			int result = ioUringEnter(ring, unsubmitted, 0, 0);
+			if (result < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				// Out of kernel resources for now, reaping completions frees them
+				if ((errno == EAGAIN || errno == EBUSY) && inFlight)
+				{
+					complete(true);
+					continue;
+				}
+				throwErrno("io_uring_enter");
+			}
+			unsubmitted -= result;
+			inFlight += result;
+			total += result;
+		}
+		return total;
+	}
+
+	unsigned IoRing::complete(bool wait)
+	{
+		submit();
+
+		unsigned head = *cqHead;
+		if (wait && inFlight && head == loadAcquire(cqTail))
+		{
+			while (ioUringEnter(ring, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+			{
+				if (errno != EINTR)
+					throwErrno("io_uring_enter");
+			}
+		}
+
+		unsigned ran = 0;
+		while (head != loadAcquire(cqTail))
+		{
+			auto *entry = (io_uring_cqe *)cqes + (head & cqMask);
+			std::unique_ptr<Callback> callback((Callback *)(uintptr_t)entry->user_data);
+			ssize_t result = entry->res;
+
+			// Release the slot before the callback so it can queue follow up requests
+			storeRelease(cqHead, ++head);
+			--inFlight;
+			++ran;
+			if (*callback)
+				(*callback)(result);
+			head = *cqHead;
+		}
+		return ran;
+	}
+
+	ThreadPoolEngine::ThreadPoolEngine(unsigned threads)
+	{
+		if (!threads)
+			threads = 1;
+		for (unsigned i = 0; i < threads; i++)
+			workers.emplace_back(&ThreadPoolEngine::run, this);
+	}
+
+	ThreadPoolEngine::~ThreadPoolEngine()
+	{
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		work.notify_all();
+		for (auto &worker : workers)
+			worker.join();
+	}
+
+	void ThreadPoolEngine::run()
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		while (true)
+		{
+			work.wait(guard, [this]
+					  { return submitted.empty() ? stopping : !(isSync(submitted.front()) && running); });
+			if (submitted.empty())
+				return;
+
+			Request request = std::move(submitted.front());
+			submitted.pop_front();
+			running++;
+			guard.unlock();
+
+			int fd = request.fd.fd;
+			ssize_t result = 0;
+			do
+			{
+				switch (request.operation)
+				{
+				case Operation::Read:
+					result = request.offset < 0 ? ::read(fd, request.buffer, request.bytes) : ::pread(fd, request.buffer, request.bytes, request.offset);
+					break;
+				case Operation::Write:
+					result = request.offset < 0 ? ::write(fd, request.buffer, request.bytes) : ::pwrite(fd, request.buffer, request.bytes, request.offset);
+					break;
+				case Operation::Fsync:
+					result = ::fsync(fd);
+					break;
+				case Operation::Fdatasync:
+					result = ::fdatasync(fd);
+					break;
+				case Operation::Close:
+					// Retrying close(2) after EINTR could close a descriptor someone else just opened
+					result = ::close(fd);
+					if (result < 0 && errno == EINTR)
+						result = 0;
+					break;
+				}
+			} while (result < 0 && errno == EINTR);
+			request.result = result < 0 ? -errno : result;
+
+			guard.lock();
+			finished.push_back(std::move(request));
+			done.notify_one();
+			// An fsync held back at the front of the queue may go now
+			if (!--running && !submitted.empty())
+				work.notify_all();
+		}
+	}
+
+	int ThreadPoolEngine::resolve(Descriptor fd) const
+	{
+		if (!fd.registered)
+			return fd.fd;
+		if ((size_t)fd.fd >= files.size())
+			return -1;
+		return files[fd.fd];
+	}
+
+	void ThreadPoolEngine::queue(Request request)
+	{
+		request.fd = resolve(request.fd);
+		queued.push_back(std::move(request));
+	}
+
+	void ThreadPoolEngine::read(Descriptor fd, void *buffer, size_t bytes, off_t offset, Callback callback)
+	{
+		queue({Operation::Read, fd, buffer, bytes, offset, std::move(callback)});
+	}
+
+	void ThreadPoolEngine::write(Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback)
+	{
+		queue({Operation::Write, fd, (void *)buffer, bytes, offset, std::move(callback)});
+	}
+
+	void ThreadPoolEngine::fsync(Descriptor fd, bool dataOnly, Callback callback)
+	{
+		queue({dataOnly ? Operation::Fdatasync : Operation::Fsync, fd, nullptr, 0, 0, std::move(callback)});
+	}
+
+	void ThreadPoolEngine::close(int fd, Callback callback)
+	{
+		queue({Operation::Close, fd, nullptr, 0, 0, std::move(callback)});
+	}
+
+	void ThreadPoolEngine::readFixed(Descriptor fd, void *buffer, size_t bytes, off_t offset, unsigned, Callback callback)
+	{
+		read(fd, buffer, bytes, offset, std::move(callback));
+	}
+
+	void ThreadPoolEngine::writeFixed(Descriptor fd, const void *buffer, size_t bytes, off_t offset, unsigned, Callback callback)
+	{
+		write(fd, buffer, bytes, offset, std::move(callback));
+	}
+
+	void ThreadPoolEngine::registerFiles(std::span<const int> fds)
+	{
+		files.assign(fds.begin(), fds.end());
+	}
+
+	void ThreadPoolEngine::unregisterFiles()
+	{
+		files.clear();
+	}
+
+	unsigned ThreadPoolEngine::submit()
+	{
+		if (queued.empty())
+			return 0;
+
+		unsigned count = (unsigned)queued.size();
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			for (auto &request : queued)
+				submitted.push_back(std::move(request));
+		}
+		queued.clear();
+		inFlight += count;
+		work.notify_all();
+		return count;
+	}
+
+	unsigned ThreadPoolEngine::complete(bool wait)
+	{
+		submit();
+
+		std::deque<Request> ready;
+		{
+			std::unique_lock<std::mutex> guard(mutex);
+			if (wait && inFlight)
+				done.wait(guard, [this]
+						  { return !finished.empty(); });
+			ready.swap(finished);
+		}
+
+		inFlight -= ready.size();
+		for (auto &request : ready)
+		{
+			if (request.callback)
+				request.callback(request.result);
+		}
+		return (unsigned)ready.size();
+	}
+
+	size_t ThreadPoolEngine::pending() const
+	{
+		return queued.size() + inFlight;
+	}
+} // namespace Gerk
@@ -0,0 +1,211 @@
+#ifndef INCLUDE_GERK_IO_ENGINE
+#define INCLUDE_GERK_IO_ENGINE
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace Gerk
+{
+	// Asynchronous read/write/fsync/close of raw file descriptors
+	//
+	// Requests are queued by read() and friends and handed to the kernel in one batch by submit()
+	// Callbacks are run on whichever thread calls complete(), with the byte count or -errno of the operation
+	class IoEngine
+	{
+	public:
+		using Callback = std::function<void(ssize_t result)>;
+
+		// Either a plain file descriptor or an index into the table given to registerFiles()
+		struct Descriptor
+		{
+			int fd;
+			bool registered = false;
+
+			Descriptor(int fd) : fd(fd) {}
+			static Descriptor Registered(unsigned index)
+			{
+				Descriptor descriptor((int)index);
+				descriptor.registered = true;
+				return descriptor;
+			}
+		};
+
+		// Uses io_uring when the kernel has it, otherwise a pool of threads doing blocking pread(2)/pwrite(2)
+		static std::unique_ptr<IoEngine> create(unsigned entries = 256);
+
+		virtual ~IoEngine() = default;
+
+		// offset is an absolute position, or -1 to use and advance the file offset
+		// Like read(2) and write(2) they can come back short, always so beyond 0x7ffff000 bytes
+		virtual void read(Descriptor fd, void *buffer, size_t bytes, off_t offset, Callback callback) = 0;
+		virtual void write(Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback) = 0;
+		// Starts only once every request queued before it has finished, so it covers the writes ahead of it in the same batch
+		virtual void fsync(Descriptor fd, bool dataOnly, Callback callback) = 0;
+		// Only plain descriptors can be closed
+		virtual void close(int fd, Callback callback) = 0;
+
+		// Same as read() and write() but buffer must lie inside the bufferIndex'th buffer given to registerBuffers()
+		virtual void readFixed(Descriptor fd, void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback) = 0;
+		virtual void writeFixed(Descriptor fd, const void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback) = 0;
+
+		// Pins buffers once so fixed reads and writes skip mapping them on every request, replaces any earlier set
+		virtual void registerBuffers(std::span<const iovec> buffers) = 0;
+		virtual void unregisterBuffers() = 0;
+		// Registered descriptors skip the per-request file table lookup, replaces any earlier set
+		virtual void registerFiles(std::span<const int> fds) = 0;
+		virtual void unregisterFiles() = 0;
+
+		// Hands every queued request over, returns how many were submitted
+		virtual unsigned submit() = 0;
+		// Submits, then runs the callbacks of finished requests, waiting for at least one if wait is set and any are in flight
+		// Returns how many callbacks were run
+		virtual unsigned complete(bool wait = true) = 0;
+
+		// Requests queued or submitted whose callback hasn't run yet
+		virtual size_t pending() const = 0;
+
+		// Runs complete() until nothing is pending
+		void drain();
+	};
+
+	// io_uring(7) through the raw system calls
+	class IoRing : public IoEngine
+	{
+		int ring = -1;
+
+		void *sqMapping = nullptr;
+		size_t sqMappingSize = 0;
+		void *cqMapping = nullptr;
+		size_t cqMappingSize = 0;
+		void *sqeMapping = nullptr;
+		size_t sqeMappingSize = 0;
+
+		unsigned *sqHead;
+		unsigned *sqTail;
+		unsigned sqMask;
+		unsigned *sqArray;
+		unsigned sqEntries;
+
+		unsigned *cqHead;
+		unsigned *cqTail;
+		unsigned cqMask;
+		unsigned cqEntries;
+		void *cqes;
+
+		// Queued in the submission ring but not yet passed to io_uring_enter(2)
+		unsigned unsubmitted = 0;
+		// Submitted but not yet reaped
+		size_t inFlight = 0;
+
+		void unmap();
+		// Next free submission entry, submitting or reaping to make room as needed
+		void *nextEntry();
+		// Fills in the next entry, which the kernel only sees once push() publishes it
+		void *prepare(int opcode, Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback);
+		void push();
+
+	public:
+		explicit IoRing(unsigned entries = 256);
+		~IoRing() override;
+
+		IoRing(const IoRing &) = delete;
+		IoRing &operator=(const IoRing &) = delete;
+
+		// Whether this kernel has io_uring with every operation the engine uses
+		static bool supported();
+
+		void read(Descriptor fd, void *buffer, size_t bytes, off_t offset, Callback callback) override;
+		void write(Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback) override;
+		void fsync(Descriptor fd, bool dataOnly, Callback callback) override;
+		void close(int fd, Callback callback) override;
+		void readFixed(Descriptor fd, void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback) override;
+		void writeFixed(Descriptor fd, const void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback) override;
+
+		void registerBuffers(std::span<const iovec> buffers) override;
+		void unregisterBuffers() override;
+		void registerFiles(std::span<const int> fds) override;
+		void unregisterFiles() override;
+
+		unsigned submit() override;
+		unsigned complete(bool wait = true) override;
+		size_t pending() const override { return unsubmitted + inFlight; }
+	};
+
+	// Fallback for kernels without io_uring, worker threads run each request as a blocking system call
+	class ThreadPoolEngine : public IoEngine
+	{
+		enum class Operation
+		{
+			Read,
+			Write,
+			Fsync,
+			Fdatasync,
+			Close,
+		};
+
+		struct Request
+		{
+			Operation operation;
+			Descriptor fd;
+			void *buffer;
+			size_t bytes;
+			off_t offset;
+			Callback callback;
+			ssize_t result = 0;
+		};
+
+		std::vector<std::thread> workers;
+
+		// Only touched by the thread driving the engine
+		std::vector<Request> queued;
+		std::vector<int> files;
+
+		std::mutex mutex;
+		std::condition_variable work;
+		std::condition_variable done;
+		std::deque<Request> submitted;
+		std::deque<Request> finished;
+		size_t inFlight = 0;
+		// Taken by a worker and not finished yet, an fsync waits at the front of submitted until this drops to zero
+		size_t running = 0;
+		bool stopping = false;
+
+		static bool isSync(const Request &request) { return request.operation == Operation::Fsync || request.operation == Operation::Fdatasync; }
+		void run();
+		void queue(Request request);
+		int resolve(Descriptor fd) const;
+
+	public:
+		explicit ThreadPoolEngine(unsigned threads = std::thread::hardware_concurrency());
+		~ThreadPoolEngine() override;
+
+		void read(Descriptor fd, void *buffer, size_t bytes, off_t offset, Callback callback) override;
+		void write(Descriptor fd, const void *buffer, size_t bytes, off_t offset, Callback callback) override;
+		void fsync(Descriptor fd, bool dataOnly, Callback callback) override;
+		void close(int fd, Callback callback) override;
+		void readFixed(Descriptor fd, void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback) override;
+		void writeFixed(Descriptor fd, const void *buffer, size_t bytes, off_t offset, unsigned bufferIndex, Callback callback) override;
+
+		// Nothing to pin without a kernel ring, fixed requests go through the normal path
+		void registerBuffers(std::span<const iovec>) override {}
+		void unregisterBuffers() override {}
+		void registerFiles(std::span<const int> fds) override;
+		void unregisterFiles() override;
+
+		unsigned submit() override;
+		unsigned complete(bool wait = true) override;
+		size_t pending() const override;
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_IO_ENGINE
@@ -0,0 +1,203 @@
+#include "lineIndex.h"
+#include "parallelLineReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <sys/stat.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		// Sidecar layout, native byte order: magic, version, stride, lines, file size, mtime, delimiter length and bytes,
+		// chunk count and chunks, checkpoint count and checkpoints
+		// A sidecar from a machine of the other byte order fails the magic check and is rebuilt
+		constexpr uint64_t SidecarMagic = 0x5844494c4b524547; // "GERKLIDX"
+		constexpr uint32_t SidecarVersion = 1;
+
+		template <typename Value>
+		void put(std::string &out, const Value &value)
+		{
+			out.append((const char *)&value, sizeof(value));
+		}
+
+		// Walks a sidecar read into memory, every get fails once the data runs out
+		struct Cursor
+		{
+			std::string_view data;
+
+			template <typename Value>
+			bool get(Value &value)
+			{
+				if (data.size() < sizeof(value))
+					return false;
+				std::memcpy(&value, data.data(), sizeof(value));
+				data.remove_prefix(sizeof(value));
+				return true;
+			}
+
+			template <typename Value>
+			bool get(std::vector<Value> &values, uint64_t count)
+			{
+				if (count > data.size() / sizeof(Value))
+					return false;
+				values.resize(count);
+				std::memcpy(values.data(), data.data(), count * sizeof(Value));
+				data.remove_prefix(count * sizeof(Value));
+				return true;
+			}
+		};
+
+		struct stat statFile(const File &file)
+		{
+			struct stat st;
+			if (::fstat(file.descriptor(), &st) < 0)
+				throwErrno("fstat");
+			return st;
+		}
+	} // namespace
+
+	LineIndex::LineIndex(File &file, Options options)
+		: strideLines(options.stride ? options.stride : 1), delimiterValue(options.delimiter)
+	{
+		ParallelLineReader reader(file, {options.threads, options.chunkBytes, ParallelLineReader::Ordering::PerChunk, options.delimiter});
+		const struct stat st = statFile(file);
+		fileSize = reader.size();
+		modifiedSeconds = st.st_mtim.tv_sec;
+		modifiedNanoseconds = st.st_mtim.tv_nsec;
+
+		// Each range records checkpoints at its own multiples of the stride, counted from its first line
+		struct Counted
+		{
+			uint64_t lines = 0;
+			std::vector<uint64_t> checkpoints;
+		};
+		std::vector<Counted> counted(reader.chunks());
+		const DelimiterScanner scanner(options.delimiter);
+		reader.runChunks([&](size_t chunk, size_t offset, std::string_view range)
+						 {
+							 Counted &into = counted[chunk];
+							 DelimiterScanner::State state;
+							 size_t at = 0;
+							 while (at < range.size())
+							 {
+								 if (into.lines % strideLines == 0)
+									 into.checkpoints.push_back(offset + at);
+								 into.lines++;
+								 size_t found = scanner.find(range.data(), range.size(), at, state);
+								 if (found == DelimiterScanner::npos)
+									 break;
+								 at = found + scanner.size();
+							 } });
+
+		for (Counted &range : counted)
+		{
+			if (!range.lines)
+				continue;
+			chunks.push_back({lineCount, checkpoints.size()});
+			checkpoints.insert(checkpoints.end(), range.checkpoints.begin(), range.checkpoints.end());
+			lineCount += range.lines;
+		}
+	}
+
+	LineIndex LineIndex::open(File &file, const std::string &sidecar, Options options)
+	{
+		// Flushed first so the size and mtime compared are those of what is about to be indexed
+		file.flush();
+		LineIndex index;
+		if (index.load(sidecar, options))
+		{
+			const struct stat st = statFile(file);
+			if (index.fileSize == (uint64_t)st.st_size && index.modifiedSeconds == st.st_mtim.tv_sec && index.modifiedNanoseconds == st.st_mtim.tv_nsec)
+				return index;
+		}
+
+		LineIndex built(file, std::move(options));
+		built.save(sidecar);
+		return built;
+	}
+
+	bool LineIndex::load(const std::string &sidecar, const Options &options)
+	{
+		std::string data;
+		try
+		{
+			File in(sidecar, File::Access::ReadOnly);
+			data.resize(statFile(in).st_size);
+			data.resize(in.readAt(0, data.data(), data.size()));
+		}
+		catch (const std::system_error &)
+		{
+			// Missing or unreadable, either way it gets rebuilt
+			return false;
+		}
+
+		Cursor cursor{data};
+		uint64_t magic, stride, delimiterLength, chunkCount, checkpointCount;
+		uint32_t version;
+		if (!cursor.get(magic) || magic != SidecarMagic || !cursor.get(version) || version != SidecarVersion)
+			return false;
+		if (!cursor.get(stride) || stride != (options.stride ? options.stride : 1) || !cursor.get(lineCount) || !cursor.get(fileSize) ||
+			!cursor.get(modifiedSeconds) || !cursor.get(modifiedNanoseconds) || !cursor.get(delimiterLength) || delimiterLength > cursor.data.size())
+			return false;
+		delimiterValue = cursor.data.substr(0, delimiterLength);
+		cursor.data.remove_prefix(delimiterLength);
+		if (delimiterValue != options.delimiter)
+			return false;
+		if (!cursor.get(chunkCount) || !cursor.get(chunks, chunkCount) || !cursor.get(checkpointCount) || !cursor.get(checkpoints, checkpointCount) || !cursor.data.empty())
+			return false;
+		strideLines = stride;
+
+		// Damage that still parses would otherwise send locate() out of bounds
+		for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+		{
+			uint64_t nextLine = chunk + 1 < chunks.size() ? chunks[chunk + 1].firstLine : lineCount;
+			uint64_t nextCheckpoint = chunk + 1 < chunks.size() ? chunks[chunk + 1].firstCheckpoint : checkpoints.size();
+			if (nextLine <= chunks[chunk].firstLine || nextCheckpoint - chunks[chunk].firstCheckpoint != (nextLine - chunks[chunk].firstLine + stride - 1) / stride)
+				return false;
+		}
+		return !chunks.empty() ? chunks.front().firstLine == 0 && chunks.front().firstCheckpoint == 0 : lineCount == 0 && checkpoints.empty();
+	}
+
+	void LineIndex::save(const std::string &sidecar) const
+	{
+		std::string out;
+		put(out, SidecarMagic);
+		put(out, SidecarVersion);
+		put(out, (uint64_t)strideLines);
+		put(out, lineCount);
+		put(out, fileSize);
+		put(out, modifiedSeconds);
+		put(out, modifiedNanoseconds);
+		put(out, (uint64_t)delimiterValue.size());
+		out += delimiterValue;
+		put(out, (uint64_t)chunks.size());
+		out.append((const char *)chunks.data(), chunks.size() * sizeof(Chunk));
+		put(out, (uint64_t)checkpoints.size());
+		out.append((const char *)checkpoints.data(), checkpoints.size() * sizeof(uint64_t));
+
+		const std::filesystem::path path(sidecar);
+		const std::string directory = path.has_parent_path() ? path.parent_path().string() : ".";
+		File staged = File::createAnonymous(directory, (File::Permissions)0644);
+		staged.write(out.data(), out.size());
+		staged.publish(path.filename().string());
+	}
+
+	LineIndex::Position LineIndex::locate(uint64_t line) const
+	{
+		if (line >= lineCount)
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "LineIndex::locate");
+		auto after = std::upper_bound(chunks.begin(), chunks.end(), line, [](uint64_t line, const Chunk &chunk)
+									  { return line < chunk.firstLine; });
+		const Chunk &chunk = *(after - 1);
+		uint64_t local = line - chunk.firstLine;
+		return {checkpoints[chunk.firstCheckpoint + local / strideLines], (size_t)(local % strideLines)};
+	}
+} // namespace Gerk
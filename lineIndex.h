@@ -0,0 +1,84 @@
+#ifndef INCLUDE_GERK_LINE_INDEX
+#define INCLUDE_GERK_LINE_INDEX
+
+#include "file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Gerk
+{
+	// Offset of every stride-th line of an immutable file, so line n is one lookup and at most stride - 1 lines of scanning away
+	//
+	// Built in one pass by ParallelLineReader's threads, each counting the lines of its range with the SIMD delimiter scanner
+	// Checkpoints are kept per range, the line numbers of a range are only known once the ranges before it are counted
+	class LineIndex
+	{
+	public:
+		struct Options
+		{
+			// Lines between checkpoints, 8 bytes of index per stride lines against a scan of up to stride - 1 on every lookup
+			size_t stride = 256;
+			// Has to match the File's delimiter when the index is used with File::seekLine()
+			std::string delimiter = "\n";
+			unsigned threads = std::thread::hardware_concurrency();
+			size_t chunkBytes = 8 << 20;
+		};
+
+		// Where line n starts to be found, seek to offset then skip that many lines
+		struct Position
+		{
+			uint64_t offset;
+			size_t skip;
+		};
+
+	private:
+		struct Chunk
+		{
+			uint64_t firstLine;
+			// Index into checkpoints of the range's first line
+			uint64_t firstCheckpoint;
+		};
+
+		size_t strideLines;
+		std::string delimiterValue;
+		uint64_t lineCount = 0;
+		// What the indexed file looked like, a sidecar is only trusted while these still match
+		uint64_t fileSize = 0;
+		int64_t modifiedSeconds = 0;
+		int64_t modifiedNanoseconds = 0;
+
+		std::vector<Chunk> chunks;
+		std::vector<uint64_t> checkpoints;
+
+		LineIndex() = default;
+		// Reads a sidecar, false if it is missing, damaged or made with other options
+		bool load(const std::string &sidecar, const Options &options);
+
+	public:
+		// Scans the whole file, its write buffer is flushed first
+		LineIndex(File &file, Options options);
+		explicit LineIndex(File &file) : LineIndex(file, Options()) {}
+
+		// Loads the index saved at sidecar when it was made with the same options for a file of the same size and mtime,
+		// otherwise builds it and saves it there for next time
+		static LineIndex open(File &file, const std::string &sidecar, Options options);
+		static LineIndex open(File &file, const std::string &sidecar) { return open(file, sidecar, Options()); }
+		// Replaces sidecar atomically, readers never see it half written
+		void save(const std::string &sidecar) const;
+
+		// Lines in the file, the last one doesn't need a delimiter
+		uint64_t lines() const { return lineCount; }
+		size_t stride() const { return strideLines; }
+		std::string_view delimiter() const { return delimiterValue; }
+
+		// line has to be below lines()
+		Position locate(uint64_t line) const;
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_LINE_INDEX
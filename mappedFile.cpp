@@ -0,0 +1,89 @@
+#include "mappedFile.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+	} // namespace
+
+	MappedFile::MappedFile(File &file, Options options)
+	{
+		file.flush();
+
+		struct stat info;
+		if (::fstat(file.descriptor(), &info) < 0)
+			throwErrno("fstat");
+
+		// mmap(2) refuses zero length mappings, an empty file is just an empty view
+		length = info.st_size;
+		if (!length)
+			return;
+
+		void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED | (options.populate ? MAP_POPULATE : 0), file.descriptor(), 0);
+		if (mapped == MAP_FAILED)
+			throwErrno("mmap");
+		data = (const char *)mapped;
+
+		// Both are hints, the mapping is usable whether or not the kernel takes them
+		if (options.hugePages)
+			::madvise(mapped, length, MADV_HUGEPAGE);
+		if (options.advice != Advice::Normal)
+			::madvise(mapped, length, (int)options.advice);
+	}
+
+	MappedFile::MappedFile(MappedFile &&other)
+		: data(other.data), length(other.length), cursor(other.cursor), delimiter(other.delimiter), scanState(other.scanState)
+	{
+		other.data = nullptr;
+		other.length = other.cursor = 0;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data)
+			::munmap((void *)data, length);
+	}
+
+	void MappedFile::advise(Advice advice, size_t offset, size_t bytes)
+	{
+		if (offset >= length)
+			return;
+		bytes = std::min(bytes, length - offset);
+
+		// madvise(2) wants a page aligned start
+		static const size_t page = ::sysconf(_SC_PAGESIZE);
+		size_t aligned = offset & ~(page - 1);
+		if (::madvise((void *)(data + aligned), bytes + (offset - aligned), (int)advice) < 0)
+			throwErrno("madvise");
+	}
+
+	std::optional<std::string_view> MappedFile::readLineView()
+	{
+		if (cursor >= length)
+			return std::nullopt;
+
+		const char *begin = data + cursor;
+		size_t found = delimiter.find(data, length, cursor, scanState);
+		if (found == DelimiterScanner::npos)
+		{
+			std::string_view last(begin, length - cursor);
+			cursor = length;
+			return last;
+		}
+
+		std::string_view line(begin, found - cursor);
+		cursor = found + delimiter.size();
+		return line;
+	}
+} // namespace Gerk
@@ -0,0 +1,86 @@
+#ifndef INCLUDE_GERK_MAPPED_FILE
+#define INCLUDE_GERK_MAPPED_FILE
+
+#include "delimiterScanner.h"
+#include "file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <sys/mman.h>
+
+namespace Gerk
+{
+	// Read only mmap(2) of a whole File, the mapping stays valid after the File is closed
+	class MappedFile
+	{
+	public:
+		enum class Advice : int
+		{
+			// No special treatment
+			Normal = MADV_NORMAL,
+
+			// Expect page references in sequential order, pages can be aggressively read ahead and freed soon after they are accessed
+			Sequential = MADV_SEQUENTIAL,
+
+			// Expect page references in random order, read ahead is less useful than normal
+			Random = MADV_RANDOM,
+
+			// Expect access in the near future, start reading the pages in now
+			WillNeed = MADV_WILLNEED,
+		};
+
+		struct Options
+		{
+			Advice advice = Advice::Normal;
+
+			// MAP_POPULATE, fault the whole file in up front instead of on first access
+			bool populate = false;
+
+			// MADV_HUGEPAGE, back the mapping with transparent huge pages where the filesystem supports it
+			bool hugePages = false;
+		};
+
+	private:
+		const char *data = nullptr;
+		size_t length = 0;
+
+		// Position of readLineView()
+		size_t cursor = 0;
+		DelimiterScanner delimiter;
+		DelimiterScanner::State scanState;
+
+	public:
+		// Maps the current size of the file, flushing its write buffer first
+		explicit MappedFile(File &file, Options options);
+		explicit MappedFile(File &file) : MappedFile(file, Options()) {}
+		MappedFile(MappedFile &&other);
+		~MappedFile();
+
+		std::span<const std::byte> bytes() const { return {(const std::byte *)data, length}; }
+		std::string_view view() const { return {data, length}; }
+		size_t size() const { return length; }
+
+		// madvise(2) over [offset, offset + bytes), defaults to the whole mapping
+		void advise(Advice advice, size_t offset = 0, size_t bytes = SIZE_MAX);
+
+		// Next line of the mapping without its delimiter, pointing straight into the mapped pages
+		std::optional<std::string_view> readLineView();
+		// Moves readLineView() back to the start of the mapping
+		void rewind() { cursor = 0; }
+		// Lines end at delimiter instead of '\n'
+		void setDelimiter(std::string_view delimiter)
+		{
+			this->delimiter = DelimiterScanner(delimiter);
+			scanState.reset();
+		}
+
+		// Range over readLineView(), for (std::string_view line : mapped.lines())
+		using Lines = LineRange<MappedFile>;
+		Lines lines() { return Lines(*this); }
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_MAPPED_FILE
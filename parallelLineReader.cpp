@@ -0,0 +1,205 @@
+#include "parallelLineReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+namespace Gerk
+{
+	namespace
+	{
+		// Calls visit for every line of [begin, end), the last one may lack its delimiter
+		template <typename Visit>
+		void forEachLine(const DelimiterScanner &delimiter, const char *begin, const char *end, Visit &&visit)
+		{
+			DelimiterScanner::State state;
+			const size_t bytes = end - begin;
+			size_t at = 0;
+			while (at < bytes)
+			{
+				size_t found = delimiter.find(begin, bytes, at, state);
+				size_t stop = found == DelimiterScanner::npos ? bytes : found;
+				visit(std::string_view(begin + at, stop - at));
+				at = stop + delimiter.size();
+			}
+		}
+
+		// One deque of range indices per worker, the owner pops the front and thieves take the back
+		class WorkQueues
+		{
+			struct Queue
+			{
+				std::mutex mutex;
+				std::deque<size_t> chunks;
+			};
+			std::vector<Queue> queues;
+
+		public:
+			WorkQueues(size_t workers, size_t chunks) : queues(workers)
+			{
+				// Contiguous blocks keep each worker walking the file forwards until it has to steal
+				for (size_t chunk = 0; chunk < chunks; chunk++)
+					queues[chunk * workers / chunks].chunks.push_back(chunk);
+			}
+
+			bool next(size_t worker, size_t &chunk)
+			{
+				{
+					Queue &own = queues[worker];
+					std::lock_guard<std::mutex> guard(own.mutex);
+					if (!own.chunks.empty())
+					{
+						chunk = own.chunks.front();
+						own.chunks.pop_front();
+						return true;
+					}
+				}
+				for (size_t i = 1; i < queues.size(); i++)
+				{
+					Queue &victim = queues[(worker + i) % queues.size()];
+					std::lock_guard<std::mutex> guard(victim.mutex);
+					if (!victim.chunks.empty())
+					{
+						chunk = victim.chunks.back();
+						victim.chunks.pop_back();
+						return true;
+					}
+				}
+				return false;
+			}
+		};
+	} // namespace
+
+	ParallelLineReader::ParallelLineReader(File &file, Options options)
+		: mapped(file, {MappedFile::Advice::Sequential, false, false}), options(options), delimiter(this->options.delimiter)
+	{
+		if (!this->options.threads)
+			this->options.threads = 1;
+		if (!this->options.chunkBytes)
+			this->options.chunkBytes = 1;
+
+		// Snap every nominal split point forward to just past the next delimiter
+		const std::string_view data = mapped.view();
+		boundaries.push_back(0);
+		for (size_t split = this->options.chunkBytes; split < data.size(); split += this->options.chunkBytes)
+		{
+			size_t from = std::max(split, boundaries.back());
+			if (from >= data.size())
+				break;
+			// Starting a little early finds a delimiter that ends exactly at the split point
+			size_t back = std::min(from - boundaries.back(), delimiter.size());
+			size_t found = delimiter.find(data.data(), data.size(), from - back);
+			if (found == DelimiterScanner::npos || found + delimiter.size() >= data.size())
+				break;
+			if (found + delimiter.size() > boundaries.back())
+				boundaries.push_back(found + delimiter.size());
+		}
+		boundaries.push_back(data.size());
+	}
+
+	void ParallelLineReader::schedule(const std::function<void(size_t chunk, const std::atomic<bool> &aborted)> &process)
+	{
+		const size_t count = chunks();
+		if (!count || boundaries.back() == 0)
+			return;
+
+		const unsigned workers = (unsigned)std::min<size_t>(options.threads, count);
+		WorkQueues queues(workers, count);
+
+		std::atomic<bool> aborted = false;
+		std::mutex failureMutex;
+		std::exception_ptr failure;
+
+		auto work = [&](size_t worker)
+		{
+			size_t chunk;
+			while (queues.next(worker, chunk))
+			{
+				try
+				{
+					process(chunk, aborted);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> guard(failureMutex);
+					if (!failure)
+						failure = std::current_exception();
+					aborted.store(true);
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned worker = 1; worker < workers; worker++)
+			threads.emplace_back(work, worker);
+		work(0);
+		for (auto &thread : threads)
+			thread.join();
+
+		if (failure)
+			std::rethrow_exception(failure);
+	}
+
+	void ParallelLineReader::run(const Callback &callback)
+	{
+		const char *data = mapped.view().data();
+		if (options.ordering == Ordering::PerChunk)
+		{
+			schedule([&](size_t chunk, const std::atomic<bool> &aborted)
+					 {
+						 if (!aborted.load(std::memory_order_relaxed))
+							 forEachLine(delimiter, data + boundaries[chunk], data + boundaries[chunk + 1], callback); });
+			return;
+		}
+
+		// Global ordering hands delivery from one range to the next
+		std::mutex turnMutex;
+		std::condition_variable turnChanged;
+		size_t turn = 0;
+
+		schedule([&](size_t chunk, const std::atomic<bool> &aborted)
+				 {
+					 // The turn has to move on even when this range fails, or the ranges after it wait forever
+					 auto advance = [&]
+					 {
+						 std::lock_guard<std::mutex> guard(turnMutex);
+						 ++turn;
+						 turnChanged.notify_all();
+					 };
+
+					 std::vector<std::string_view> lines;
+					 try
+					 {
+						 forEachLine(delimiter, data + boundaries[chunk], data + boundaries[chunk + 1], [&](std::string_view line)
+									 { lines.push_back(line); });
+
+						 std::unique_lock<std::mutex> guard(turnMutex);
+						 turnChanged.wait(guard, [&]
+										  { return turn == chunk; });
+						 guard.unlock();
+						 if (!aborted.load(std::memory_order_relaxed))
+						 {
+							 for (std::string_view line : lines)
+								 callback(line);
+						 }
+					 }
+					 catch (...)
+					 {
+						 advance();
+						 throw;
+					 }
+					 advance(); });
+	}
+
+	void ParallelLineReader::runChunks(const ChunkCallback &callback)
+	{
+		const std::string_view data = mapped.view();
+		schedule([&](size_t chunk, const std::atomic<bool> &aborted)
+				 {
+					 if (!aborted.load(std::memory_order_relaxed))
+						 callback(chunk, boundaries[chunk], data.substr(boundaries[chunk], boundaries[chunk + 1] - boundaries[chunk])); });
+	}
+} // namespace Gerk
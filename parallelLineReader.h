@@ -0,0 +1,75 @@
+#ifndef INCLUDE_GERK_PARALLEL_LINE_READER
+#define INCLUDE_GERK_PARALLEL_LINE_READER
+
+#include "delimiterScanner.h"
+#include "file.h"
+#include "mappedFile.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Gerk
+{
+	// Splits a newline delimited file into byte ranges and runs a callback for every line on a pool of threads
+	//
+	// Ranges start just after a delimiter so no line is split, idle threads steal ranges from busy ones
+	class ParallelLineReader
+	{
+	public:
+		enum class Ordering
+		{
+			// Lines of one range arrive in order on one thread, ranges run concurrently
+			PerChunk,
+			// Lines arrive one at a time in file order, only finding the line boundaries runs in parallel
+			Global,
+		};
+
+		struct Options
+		{
+			unsigned threads = std::thread::hardware_concurrency();
+			// Target size of each range, more ranges than threads lets stealing even out slow ones
+			size_t chunkBytes = 8 << 20;
+			Ordering ordering = Ordering::PerChunk;
+			// Ranges are cut and lines split on this rather than '\n'
+			std::string delimiter = "\n";
+		};
+
+		// The view points into a mapping of the file and is valid until run() returns
+		using Callback = std::function<void(std::string_view line)>;
+		// A whole range, chunk counts from 0 in file order and offset is where the range starts in the file
+		using ChunkCallback = std::function<void(size_t chunk, size_t offset, std::string_view range)>;
+
+	private:
+		MappedFile mapped;
+		Options options;
+		DelimiterScanner delimiter;
+
+		// Start offset of every range plus the end of the file
+		std::vector<size_t> boundaries;
+
+		// Runs process once for every range on the pool, catching the first exception and raising aborted for the rest
+		void schedule(const std::function<void(size_t chunk, const std::atomic<bool> &aborted)> &process);
+
+	public:
+		ParallelLineReader(File &file, Options options);
+		explicit ParallelLineReader(File &file) : ParallelLineReader(file, Options()) {}
+
+		size_t chunks() const { return boundaries.size() - 1; }
+		// Bytes of the file that were mapped
+		size_t size() const { return mapped.size(); }
+
+		// Blocks until every line has been handed to callback, rethrows the first exception a callback threw
+		// After a callback throws, the remaining lines are skipped
+		void run(const Callback &callback);
+		// Same pool and error handling, but hands over each range whole for callers that scan it themselves
+		// Ranges run concurrently in no particular order
+		void runChunks(const ChunkCallback &callback);
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_PARALLEL_LINE_READER
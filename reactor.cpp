@@ -0,0 +1,157 @@
+#include "reactor.h"
+
+#include <cerrno>
+#include <exception>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+	} // namespace
+
+	Reactor::Reactor(size_t maxEvents) : events(maxEvents ? maxEvents : 1)
+	{
+		epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		if (epoll < 0)
+			throwErrno("epoll_create1");
+		wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (wakeup < 0)
+		{
+			::close(epoll);
+			throwErrno("eventfd");
+		}
+
+		// Level triggered with no data pointer, a set eventfd keeps waking every wait until run() consumes it
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		if (::epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &event) < 0)
+		{
+			::close(wakeup);
+			::close(epoll);
+			throwErrno("epoll_ctl");
+		}
+	}
+
+	Reactor::~Reactor()
+	{
+		::close(wakeup);
+		::close(epoll);
+	}
+
+	void Reactor::add(File &file, Events interest, Callback callback)
+	{
+		const int fd = file.descriptor();
+		int flags = ::fcntl(fd, F_GETFL);
+		if (flags < 0)
+			throwErrno("fcntl");
+		if (!(flags & O_NONBLOCK) && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+			throwErrno("fcntl");
+
+		auto registration = std::make_unique<Registration>(Registration{file, std::move(callback)});
+		epoll_event event = {};
+		event.events = (uint32_t)interest | EPOLLET;
+		event.data.ptr = registration.get();
+		if (::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+			throwErrno("epoll_ctl");
+		registrations.emplace(fd, std::move(registration));
+	}
+
+	void Reactor::modify(File &file, Events interest)
+	{
+		auto found = registrations.find(file.descriptor());
+		if (found == registrations.end())
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Reactor::modify");
+
+		epoll_event event = {};
+		event.events = (uint32_t)interest | EPOLLET;
+		event.data.ptr = found->second.get();
+		if (::epoll_ctl(epoll, EPOLL_CTL_MOD, file.descriptor(), &event) < 0)
+			throwErrno("epoll_ctl");
+	}
+
+	void Reactor::remove(File &file)
+	{
+		auto found = registrations.find(file.descriptor());
+		if (found == registrations.end())
+			return;
+
+		// Fails only if the descriptor was already closed, which drops it from the epoll set anyway
+		::epoll_ctl(epoll, EPOLL_CTL_DEL, file.descriptor(), nullptr);
+		found->second->live = false;
+		retired.push_back(std::move(found->second));
+		registrations.erase(found);
+	}
+
+	size_t Reactor::poll(std::chrono::milliseconds timeout)
+	{
+		int ready;
+		do
+			ready = ::epoll_wait(epoll, events.data(), (int)events.size(), timeout.count() < 0 ? -1 : (int)timeout.count());
+		while (ready < 0 && errno == EINTR);
+		if (ready < 0)
+			throwErrno("epoll_wait");
+
+		// Edge triggered events aren't reported twice, so a throwing callback doesn't cut the batch short
+		size_t ran = 0;
+		std::exception_ptr failure;
+		for (int i = 0; i < ready; i++)
+		{
+			Registration *registration = (Registration *)events[i].data.ptr;
+			if (!registration)
+			{
+				stopping = true;
+				continue;
+			}
+			if (!registration->live)
+				continue;
+			try
+			{
+				registration->callback(registration->file, (Events)events[i].events);
+			}
+			catch (...)
+			{
+				if (!failure)
+					failure = std::current_exception();
+			}
+			ran++;
+		}
+		retired.clear();
+
+		if (failure)
+			std::rethrow_exception(failure);
+		return ran;
+	}
+
+	void Reactor::run()
+	{
+		while (!registrations.empty())
+		{
+			poll();
+			if (stopping)
+			{
+				stopping = false;
+				uint64_t count;
+				while (::read(wakeup, &count, sizeof(count)) < 0 && errno == EINTR)
+					;
+				return;
+			}
+		}
+	}
+
+	void Reactor::stop()
+	{
+		uint64_t one = 1;
+		ssize_t written;
+		do
+			written = ::write(wakeup, &one, sizeof(one));
+		while (written < 0 && errno == EINTR);
+	}
+} // namespace Gerk
@@ -0,0 +1,92 @@
+#ifndef INCLUDE_GERK_REACTOR
+#define INCLUDE_GERK_REACTOR
+
+#include "file.h"
+#include "flags.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+
+namespace Gerk
+{
+	// Waits on many non-blocking Files (pipes, FIFOs, sockets, ttys) from one thread with edge-triggered epoll(7)
+	//
+	// Edge triggered means a callback hears about new data once, so it has to read until the File runs dry,
+	// for (auto line : file.lines()) ... then carry on once file.wouldBlock(), and only write again after it is told Writable
+	// Regular files can't be waited on, epoll_ctl(2) refuses them with EPERM
+	class Reactor
+	{
+	public:
+		enum class Events : uint32_t
+		{
+			None = 0,
+			Readable = EPOLLIN,
+			Writable = EPOLLOUT,
+			// Always reported, a pipe's last writer (or reader) closed, read what is left then stop
+			Hangup = EPOLLHUP,
+			// A socket's peer shut down writing, only reported when asked for
+			PeerShutdown = EPOLLRDHUP,
+			// Always reported, the next read or write says what went wrong
+			Error = EPOLLERR,
+		};
+
+		// file is the one registered, events what it became ready for since the last call
+		using Callback = std::function<void(File &file, Events events)>;
+
+	private:
+		struct Registration
+		{
+			File &file;
+			Callback callback;
+			// Cleared by remove(), a registration removed by an earlier callback of the same batch is skipped
+			bool live = true;
+		};
+
+		int epoll = -1;
+		// Wakes poll() from stop()
+		int wakeup = -1;
+		std::unordered_map<int, std::unique_ptr<Registration>> registrations;
+		// Removed during the current batch, freed once it is over so pending events don't point at freed memory
+		std::vector<std::unique_ptr<Registration>> retired;
+		std::vector<epoll_event> events;
+		// poll() saw the eventfd, run() returns after this batch
+		bool stopping = false;
+
+	public:
+		// maxEvents is how many ready Files one epoll_wait(2) can return, more are picked up on the next call
+		explicit Reactor(size_t maxEvents = 256);
+		~Reactor();
+
+		Reactor(const Reactor &) = delete;
+		Reactor &operator=(const Reactor &) = delete;
+
+		// Watches file for interest until remove(), which also has to come before the File is closed or destroyed
+		// The descriptor is switched to O_NONBLOCK if it wasn't opened with OpenMode::NonBlocking
+		// Data already waiting counts as new, so the first callback comes straight away if there is some
+		void add(File &file, Events interest, Callback callback);
+		// Changes what file is watched for, rearming the edge
+		void modify(File &file, Events interest);
+		void remove(File &file);
+		size_t size() const { return registrations.size(); }
+
+		// Waits up to timeout (forever if negative) and runs the callbacks of every File that became ready
+		// Returns how many ran, 0 on timeout; a pending stop() keeps it from waiting at all
+		// Every ready callback runs even if one throws, the first exception is rethrown afterwards
+		size_t poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+		// poll() until stop() or nothing is registered
+		void run();
+		// Makes run() return once the callbacks already due have run, even if it was called before run(); safe from any thread
+		void stop();
+	};
+
+	template <>
+	inline constexpr bool IsFlagSet<Reactor::Events> = true;
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_REACTOR
@@ -0,0 +1,156 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace Gerk
+{
+	uint64_t LatencyHistogram::upperBound(size_t bucket)
+	{
+		if (bucket < SubBuckets)
+			return bucket;
+		unsigned magnitude = bucket / SubBuckets + 3;
+		uint64_t lower = (uint64_t)(SubBuckets + bucket % SubBuckets) << (magnitude - 4);
+		return lower + ((uint64_t)1 << (magnitude - 4)) - 1;
+	}
+
+	uint64_t LatencyHistogram::percentile(double fraction) const
+	{
+		if (!total)
+			return 0;
+		uint64_t wanted = std::max<uint64_t>(1, (uint64_t)(fraction * total + 0.5));
+		uint64_t seen = 0;
+		for (size_t bucket = 0; bucket < Buckets; bucket++)
+		{
+			seen += counts[bucket];
+			if (seen >= wanted)
+				return upperBound(bucket);
+		}
+		return upperBound(Buckets - 1);
+	}
+
+	LatencyHistogram &LatencyHistogram::operator+=(const LatencyHistogram &other)
+	{
+		for (size_t bucket = 0; bucket < Buckets; bucket++)
+			counts[bucket] += other.counts[bucket];
+		total += other.total;
+		return *this;
+	}
+
+	IoStats &IoStats::operator+=(const IoStats &other)
+	{
+		bytesRead += other.bytesRead;
+		bytesWritten += other.bytesWritten;
+		readCalls += other.readCalls;
+		writeCalls += other.writeCalls;
+		syncCalls += other.syncCalls;
+		refills += other.refills;
+		writeLatency += other.writeLatency;
+		syncLatency += other.syncLatency;
+		lockWait += other.lockWait;
+		return *this;
+	}
+
+	namespace detail
+	{
+		void StatsBlock::addTo(IoStats &stats) const
+		{
+			auto counter = [&](StatsCounter which)
+			{ return counters[(size_t)which].load(std::memory_order_relaxed); };
+			stats.bytesRead += counter(StatsCounter::BytesRead);
+			stats.bytesWritten += counter(StatsCounter::BytesWritten);
+			stats.readCalls += counter(StatsCounter::ReadCalls);
+			stats.writeCalls += counter(StatsCounter::WriteCalls);
+			stats.syncCalls += counter(StatsCounter::SyncCalls);
+			stats.refills += counter(StatsCounter::Refills);
+
+			auto histogram = [&](StatsLatency which, LatencyHistogram &into)
+			{
+				for (size_t bucket = 0; bucket < LatencyHistogram::Buckets; bucket++)
+				{
+					uint64_t times = latencies[(size_t)which][bucket].load(std::memory_order_relaxed);
+					if (times)
+						into.record(LatencyHistogram::upperBound(bucket), times);
+				}
+			};
+			histogram(StatsLatency::Write, stats.writeLatency);
+			histogram(StatsLatency::Sync, stats.syncLatency);
+			histogram(StatsLatency::LockWait, stats.lockWait);
+		}
+
+		void StatsBlock::clear()
+		{
+			for (auto &counter : counters)
+				counter.store(0, std::memory_order_relaxed);
+			for (auto &latency : latencies)
+				for (auto &bucket : latency)
+					bucket.store(0, std::memory_order_relaxed);
+		}
+
+#ifdef GERK_FILE_STATS
+		namespace
+		{
+			// Every live thread's block, plus what exited threads counted
+			struct Registry
+			{
+				std::mutex mutex;
+				std::vector<StatsBlock *> live;
+				IoStats retired;
+			};
+
+			Registry &registry()
+			{
+				// Leaked so threads exiting after static destruction can still retire their counters
+				static Registry *instance = new Registry();
+				return *instance;
+			}
+
+			struct ThreadStats
+			{
+				StatsBlock block;
+
+				ThreadStats()
+				{
+					Registry &shared = registry();
+					std::lock_guard<std::mutex> guard(shared.mutex);
+					shared.live.push_back(&block);
+				}
+
+				~ThreadStats()
+				{
+					Registry &shared = registry();
+					std::lock_guard<std::mutex> guard(shared.mutex);
+					block.addTo(shared.retired);
+					shared.live.erase(std::find(shared.live.begin(), shared.live.end(), &block));
+				}
+			};
+		} // namespace
+
+		StatsBlock &threadStats()
+		{
+			thread_local ThreadStats stats;
+			return stats.block;
+		}
+
+		IoStats globalStats()
+		{
+			Registry &shared = registry();
+			std::lock_guard<std::mutex> guard(shared.mutex);
+			IoStats stats = shared.retired;
+			for (const StatsBlock *block : shared.live)
+				block->addTo(stats);
+			return stats;
+		}
+
+		void resetGlobalStats()
+		{
+			Registry &shared = registry();
+			std::lock_guard<std::mutex> guard(shared.mutex);
+			shared.retired = IoStats();
+			for (StatsBlock *block : shared.live)
+				block->clear();
+		}
+#endif
+	} // namespace detail
+} // namespace Gerk
@@ -0,0 +1,177 @@
+#ifndef INCLUDE_GERK_STATS
+#define INCLUDE_GERK_STATS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Gerk
+{
+	// Nanosecond latencies in log-linear buckets, HdrHistogram style: 16 buckets per power of two, so within ~6% of the true value
+	class LatencyHistogram
+	{
+	public:
+		static constexpr unsigned SubBuckets = 16;
+		static constexpr size_t Buckets = (64 - 3) * SubBuckets;
+
+		static size_t bucketOf(uint64_t nanoseconds)
+		{
+			if (nanoseconds < SubBuckets)
+				return nanoseconds;
+			unsigned magnitude = 63 - __builtin_clzll(nanoseconds);
+			return (magnitude - 3) * SubBuckets + ((nanoseconds >> (magnitude - 4)) & (SubBuckets - 1));
+		}
+		// Largest value that lands in bucket
+		static uint64_t upperBound(size_t bucket);
+
+	private:
+		std::array<uint64_t, Buckets> counts{};
+		uint64_t total = 0;
+
+	public:
+		void record(uint64_t nanoseconds, uint64_t times = 1)
+		{
+			counts[bucketOf(nanoseconds)] += times;
+			total += times;
+		}
+
+		uint64_t count() const { return total; }
+		uint64_t countIn(size_t bucket) const { return counts[bucket]; }
+		// Smallest bucket bound at or below which fraction (0 to 1) of the values lie, 0 when empty
+		uint64_t percentile(double fraction) const;
+		uint64_t max() const { return percentile(1); }
+
+		LatencyHistogram &operator+=(const LatencyHistogram &other);
+	};
+
+	// What the File calls were spent on, see File::stats() and File::globalStats()
+	// Every field stays zero unless the library is built with GERK_FILE_STATS
+	struct IoStats
+	{
+		uint64_t bytesRead = 0;
+		uint64_t bytesWritten = 0;
+		// System calls issued, each retry of a short transfer counts
+		uint64_t readCalls = 0;
+		uint64_t writeCalls = 0;
+		uint64_t syncCalls = 0;
+		// Times readLine() and friends had to refill the read buffer
+		uint64_t refills = 0;
+
+		// write(2) family, fsync(2)/fdatasync(2) and the time lock()/lock_shared() waited
+		LatencyHistogram writeLatency;
+		LatencyHistogram syncLatency;
+		LatencyHistogram lockWait;
+
+		IoStats &operator+=(const IoStats &other);
+	};
+
+	namespace detail
+	{
+		enum class StatsCounter
+		{
+			BytesRead,
+			BytesWritten,
+			ReadCalls,
+			WriteCalls,
+			SyncCalls,
+			Refills,
+			Count,
+		};
+
+		enum class StatsLatency
+		{
+			Write,
+			Sync,
+			LockWait,
+			Count,
+		};
+
+		// Relaxed atomics so snapshots can be read while the owners keep counting
+		struct StatsBlock
+		{
+			std::array<std::atomic<uint64_t>, (size_t)StatsCounter::Count> counters{};
+			std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::Buckets>, (size_t)StatsLatency::Count> latencies{};
+
+			void add(StatsCounter counter, uint64_t amount) { counters[(size_t)counter].fetch_add(amount, std::memory_order_relaxed); }
+			void record(StatsLatency latency, uint64_t nanoseconds) { latencies[(size_t)latency][LatencyHistogram::bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed); }
+			void addTo(IoStats &stats) const;
+			void clear();
+		};
+
+#ifdef GERK_FILE_STATS
+		// Counters of the calling thread, merged with those of every other thread by globalStats()
+		StatsBlock &threadStats();
+		IoStats globalStats();
+		void resetGlobalStats();
+
+		// Per File counters, only allocated once enable() is called, while the thread's counters always run
+		class StatsHandle
+		{
+			std::unique_ptr<StatsBlock> block;
+
+		public:
+			void enable()
+			{
+				if (!block)
+					block = std::make_unique<StatsBlock>();
+			}
+			IoStats snapshot() const
+			{
+				IoStats stats;
+				if (block)
+					block->addTo(stats);
+				return stats;
+			}
+
+			void count(StatsCounter counter, uint64_t amount = 1) const
+			{
+				threadStats().add(counter, amount);
+				if (block)
+					block->add(counter, amount);
+			}
+			void record(StatsLatency latency, uint64_t nanoseconds) const
+			{
+				threadStats().record(latency, nanoseconds);
+				if (block)
+					block->record(latency, nanoseconds);
+			}
+		};
+
+		// Records the time from construction to destruction
+		class StatsTimer
+		{
+			const StatsHandle &handle;
+			StatsLatency latency;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		public:
+			StatsTimer(const StatsHandle &handle, StatsLatency latency) : handle(handle), latency(latency) {}
+			~StatsTimer() { handle.record(latency, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()); }
+		};
+#else
+		inline IoStats globalStats() { return {}; }
+		inline void resetGlobalStats() {}
+
+		// Compiled out, empty and every call a no-op
+		class StatsHandle
+		{
+		public:
+			void enable() {}
+			IoStats snapshot() const { return {}; }
+			void count(StatsCounter, uint64_t = 1) const {}
+			void record(StatsLatency, uint64_t) const {}
+		};
+
+		class StatsTimer
+		{
+		public:
+			StatsTimer(const StatsHandle &, StatsLatency) {}
+		};
+#endif
+	} // namespace detail
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_STATS
@@ -0,0 +1,248 @@
+#include "tailFile.h"
+
+#include <cerrno>
+#include <filesystem>
+#include <system_error>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Gerk
+{
+	namespace
+	{
+		[[noreturn]] void throwErrno(const char *what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		// Changes to the file itself, IN_ATTRIB also covers the last link being removed while it is still open
+		constexpr uint32_t FileEvents = IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB;
+		// A new file appearing under the name
+		constexpr uint32_t DirectoryEvents = IN_CREATE | IN_MOVED_TO;
+	} // namespace
+
+	TailFile::TailFile(std::string path, Options options) : path(std::move(path)), options(std::move(options))
+	{
+		try
+		{
+			inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (inotify < 0)
+				throwErrno("inotify_init1");
+			wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (wakeup < 0)
+				throwErrno("eventfd");
+
+			const std::filesystem::path location(this->path);
+			name = location.filename().string();
+			if (this->options.followRotation)
+			{
+				const std::string directory = location.has_parent_path() ? location.parent_path().string() : ".";
+				directoryWatch = ::inotify_add_watch(inotify, directory.c_str(), DirectoryEvents | IN_ONLYDIR);
+				if (directoryWatch < 0)
+					throwErrno("inotify_add_watch");
+			}
+
+			if (!openFile(this->options.startAtEnd))
+				throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "open");
+		}
+		catch (...)
+		{
+			if (wakeup >= 0)
+				::close(wakeup);
+			if (inotify >= 0)
+				::close(inotify);
+			throw;
+		}
+	}
+
+	TailFile::~TailFile()
+	{
+		// Closing the inotify descriptor drops its watches too
+		file.reset();
+		::close(inotify);
+		::close(wakeup);
+	}
+
+	bool TailFile::openFile(bool atEnd)
+	{
+		std::optional<File> opened;
+		try
+		{
+			opened.emplace(path, File::Access::ReadOnly, File::OpenMode::CloseOnExecute, (File::Permissions)0, options.readBufferSize);
+		}
+		catch (const std::system_error &error)
+		{
+			if (error.code() == std::errc::no_such_file_or_directory)
+				return false;
+			throw;
+		}
+
+		struct stat st;
+		if (::fstat(opened->descriptor(), &st) < 0)
+			throwErrno("fstat");
+
+		// Watched through the descriptor, so the watch is on the inode just opened even if the path was replaced since
+		const std::string self = "/proc/self/fd/" + std::to_string(opened->descriptor());
+		int watch = ::inotify_add_watch(inotify, self.c_str(), FileEvents);
+		if (watch < 0)
+			throwErrno("inotify_add_watch");
+		// Removing fails once the kernel dropped the watch itself, after the old file was deleted
+		if (fileWatch >= 0 && fileWatch != watch)
+			::inotify_rm_watch(inotify, fileWatch);
+		fileWatch = watch;
+
+		opened->setDelimiter(options.delimiter);
+		if (atEnd)
+			opened->seek(0, SEEK_END);
+		file.reset();
+		file.emplace(std::move(*opened));
+		device = st.st_dev;
+		inode = st.st_ino;
+		maybeRotated = false;
+		return true;
+	}
+
+	void TailFile::drainEvents()
+	{
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			ssize_t got = ::read(inotify, buffer, sizeof(buffer));
+			if (got < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN)
+					return;
+				throwErrno("read");
+			}
+
+			for (char *at = buffer; at < buffer + got;)
+			{
+				const inotify_event *event = (const inotify_event *)at;
+				if (event->wd == fileWatch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB | IN_IGNORED)))
+					maybeRotated = true;
+				else if (event->wd == directoryWatch && event->len && name == event->name)
+					maybeRotated = true;
+				// The queue overflowed, anything could have happened
+				else if (event->mask & IN_Q_OVERFLOW)
+					maybeRotated = true;
+				at += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+
+	bool TailFile::checkTruncated()
+	{
+		struct stat st;
+		if (::fstat(file->descriptor(), &st) < 0)
+			throwErrno("fstat");
+		// The descriptor's offset includes the read-ahead, so this is how far has been read
+		off_t read = ::lseek(file->descriptor(), 0, SEEK_CUR);
+		if (read < 0)
+			throwErrno("lseek");
+		if (st.st_size >= read)
+			return false;
+
+		// Whatever partial line was buffered is gone with the rest
+		file->seek(0);
+		truncationCount++;
+		return true;
+	}
+
+	bool TailFile::pathReplaced()
+	{
+		struct stat st;
+		if (::stat(path.c_str(), &st) < 0)
+		{
+			if (errno == ENOENT)
+				return false;
+			throwErrno("stat");
+		}
+		if (st.st_dev == device && st.st_ino == inode)
+		{
+			maybeRotated = false;
+			return false;
+		}
+		return true;
+	}
+
+	bool TailFile::wait(int timeoutMilliseconds)
+	{
+		pollfd fds[2] = {{inotify, POLLIN, 0}, {wakeup, POLLIN, 0}};
+		int ready;
+		do
+			ready = ::poll(fds, 2, timeoutMilliseconds);
+		while (ready < 0 && errno == EINTR);
+		if (ready < 0)
+			throwErrno("poll");
+		// The eventfd is never read, so once stopped every wait returns straight away
+		return ready > 0 && !(fds[1].revents & POLLIN);
+	}
+
+	std::optional<std::string_view> TailFile::follow(int timeoutMilliseconds)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+		while (true)
+		{
+			// Events are taken before reading, so one for data arriving after the read below is still queued for wait()
+			drainEvents();
+			if (auto line = file->readCompleteLineView())
+				return line;
+
+			if (checkTruncated())
+				continue;
+
+			if (maybeRotated && options.followRotation && pathReplaced())
+			{
+				// The old file won't grow any more, its last line is complete even without a delimiter
+				if (auto last = file->readLineView())
+					return last;
+				if (openFile(false))
+				{
+					rotationCount++;
+					continue;
+				}
+			}
+
+			int remaining = -1;
+			if (timeoutMilliseconds >= 0)
+			{
+				auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				remaining = left > 0 ? (int)left : 0;
+			}
+			if (!wait(remaining))
+			{
+				// One last look, the deadline may have passed while the line arrived
+				drainEvents();
+				return file->readCompleteLineView();
+			}
+		}
+	}
+
+	std::optional<std::string> TailFile::readLine()
+	{
+		if (auto line = readLineView())
+			return std::string(*line);
+		return std::nullopt;
+	}
+
+	std::optional<std::string> TailFile::readLine(std::chrono::milliseconds timeout)
+	{
+		if (auto line = readLineView(timeout))
+			return std::string(*line);
+		return std::nullopt;
+	}
+
+	void TailFile::stop()
+	{
+		uint64_t one = 1;
+		ssize_t written;
+		do
+			written = ::write(wakeup, &one, sizeof(one));
+		while (written < 0 && errno == EINTR);
+	}
+} // namespace Gerk
@@ -0,0 +1,96 @@
+#ifndef INCLUDE_GERK_TAIL_FILE
+#define INCLUDE_GERK_TAIL_FILE
+
+#include "file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+namespace Gerk
+{
+	// Follows a file that is still being written, like tail -F: at end of file readLine() sleeps on inotify(7) until more arrives
+	//
+	// A half written last line stays buffered until its delimiter shows up
+	// Truncation (copytruncate) restarts from the beginning, and once the path names a new file (rename and recreate) the rest
+	// of the old one is read and the new one followed from its start
+	class TailFile
+	{
+	public:
+		struct Options
+		{
+			// Skip what is already in the file and only follow what is appended from now on
+			bool startAtEnd = false;
+			// Switch to the new file when the path is renamed away or deleted and created again, otherwise keep the old one
+			bool followRotation = true;
+			std::string delimiter = "\n";
+			size_t readBufferSize = File::DefaultReadBufferSize;
+		};
+
+	private:
+		std::string path;
+		Options options;
+		std::optional<File> file;
+		// Identity of the file being read, to tell a rotation from a spurious event
+		dev_t device = 0;
+		ino_t inode = 0;
+
+		int inotify = -1;
+		int fileWatch = -1;
+		int directoryWatch = -1;
+		// Name of the file within its directory, what directory events are matched against
+		std::string name;
+		// Wakes a waiting readLine() from stop()
+		int wakeup = -1;
+
+		// An event said the path may name another file now
+		bool maybeRotated = false;
+		uint64_t rotationCount = 0;
+		uint64_t truncationCount = 0;
+
+		// Opens path and watches it, returns false if it doesn't exist (yet)
+		bool openFile(bool atEnd);
+		// Handles every queued inotify event
+		void drainEvents();
+		// Restarts from the beginning when the file shrank below what has been read
+		bool checkTruncated();
+		// Whether path names another file than the one being read, false while it is the same or missing
+		bool pathReplaced();
+		// poll(2) until an event or the deadline, false on timeout or stop()
+		bool wait(int timeoutMilliseconds);
+		std::optional<std::string_view> follow(int timeoutMilliseconds);
+
+	public:
+		// path has to exist, std::system_error otherwise
+		explicit TailFile(std::string path, Options options);
+		explicit TailFile(std::string path) : TailFile(std::move(path), Options()) {}
+		~TailFile();
+
+		TailFile(const TailFile &) = delete;
+		TailFile &operator=(const TailFile &) = delete;
+
+		// Next complete line, waiting as long as it takes, std::nullopt only after stop()
+		// The view points into the read buffer and is valid until the next call
+		std::optional<std::string_view> readLineView() { return follow(-1); }
+		// Same but gives up after timeout, std::nullopt then too
+		std::optional<std::string_view> readLineView(std::chrono::milliseconds timeout) { return follow(timeout.count() < 0 ? 0 : (int)std::min<int64_t>(timeout.count(), INT_MAX)); }
+		std::optional<std::string> readLine();
+		std::optional<std::string> readLine(std::chrono::milliseconds timeout);
+
+		// Makes a waiting readLine() in another thread return std::nullopt, and every later one once nothing is left to read
+		// The only call that is safe alongside the others
+		void stop();
+
+		// Rotations and truncations seen so far
+		uint64_t rotations() const { return rotationCount; }
+		uint64_t truncations() const { return truncationCount; }
+	};
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_TAIL_FILE
@@ -0,0 +1,128 @@
+#ifndef INCLUDE_GERK_TASK
+#define INCLUDE_GERK_TASK
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace Gerk
+{
+	template <typename T>
+	class Task;
+
+	namespace detail
+	{
+		struct TaskPromiseBase
+		{
+			// Resumed when the task finishes, nothing if it was never awaited
+			std::coroutine_handle<> continuation = std::noop_coroutine();
+			std::exception_ptr exception;
+
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept { return false; }
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					return handle.promise().continuation;
+				}
+				void await_resume() noexcept {}
+			};
+
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+			void unhandled_exception() { exception = std::current_exception(); }
+		};
+
+		template <typename T>
+		struct TaskPromise : TaskPromiseBase
+		{
+			std::optional<T> value;
+
+			Task<T> get_return_object();
+			void return_value(T result) { value.emplace(std::move(result)); }
+			T result()
+			{
+				if (exception)
+					std::rethrow_exception(exception);
+				return std::move(*value);
+			}
+		};
+
+		template <>
+		struct TaskPromise<void> : TaskPromiseBase
+		{
+			Task<void> get_return_object();
+			void return_void() {}
+			void result()
+			{
+				if (exception)
+					std::rethrow_exception(exception);
+			}
+		};
+	} // namespace detail
+
+	// Lazily started coroutine, runs when first awaited and resumes its awaiter when done
+	// Exceptions thrown in the task are rethrown from the co_await
+	template <typename T = void>
+	class [[nodiscard]] Task
+	{
+	public:
+		using promise_type = detail::TaskPromise<T>;
+
+	private:
+		std::coroutine_handle<promise_type> handle;
+
+	public:
+		explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+		Task(Task &&other) : handle(std::exchange(other.handle, nullptr)) {}
+		Task &operator=(Task &&other)
+		{
+			if (handle)
+				handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+			return *this;
+		}
+		~Task()
+		{
+			if (handle)
+				handle.destroy();
+		}
+
+		bool done() const { return !handle || handle.done(); }
+
+		auto operator co_await() &&
+		{
+			struct Awaiter
+			{
+				std::coroutine_handle<promise_type> handle;
+
+				bool await_ready() { return !handle || handle.done(); }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+				{
+					handle.promise().continuation = awaiting;
+					return handle;
+				}
+				T await_resume() { return handle.promise().result(); }
+			};
+			return Awaiter{handle};
+		}
+	};
+
+	namespace detail
+	{
+		template <typename T>
+		Task<T> TaskPromise<T>::get_return_object()
+		{
+			return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+		}
+
+		inline Task<void> TaskPromise<void>::get_return_object()
+		{
+			return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+		}
+	} // namespace detail
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_TASK
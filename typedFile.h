@@ -0,0 +1,154 @@
+#ifndef INCLUDE_GERK_TYPED_FILE
+#define INCLUDE_GERK_TYPED_FILE
+
+#include "file.h"
+
+#include <utility>
+
+namespace Gerk
+{
+	// A File whose access mode is part of its type, so reading a WriteFile or writing a ReadFile doesn't compile
+	// Opens with exactly that mode, and a ReadFile never buffers writes while a WriteFile never allocates read-ahead
+	template <File::Access Mode>
+	class TypedFile
+	{
+		File file;
+
+	public:
+		static constexpr File::Access access = Mode;
+		static constexpr bool readable = Mode != File::Access::WriteOnly;
+		static constexpr bool writable = Mode != File::Access::ReadOnly;
+
+		TypedFile(const std::string &path, File::OpenMode flags = (File::OpenMode)0, File::Permissions mode = (File::Permissions)0, size_t readBufferSize = File::DefaultReadBufferSize)
+			: file(path, Mode, flags, mode, readBufferSize)
+		{
+		}
+
+		// The File underneath, for anything not forwarded here
+		File &get() { return file; }
+		const File &get() const { return file; }
+
+		int descriptor() const { return file.descriptor(); }
+		int release() { return file.release(); }
+		File::DirectAlignment directAlignment() const { return file.directAlignment(); }
+
+		void setReadBufferSize(size_t bytes)
+			requires readable
+		{ file.setReadBufferSize(bytes); }
+		void setDelimiter(std::string_view delimiter)
+			requires readable
+		{ file.setDelimiter(delimiter); }
+
+		std::optional<std::string> readLine()
+			requires readable
+		{ return file.readLine(); }
+		std::optional<std::string_view> readLineView()
+			requires readable
+		{ return file.readLineView(); }
+		File::Lines lines()
+			requires readable
+		{ return file.lines(); }
+		template <typename Policy>
+		std::optional<std::string_view> readRecord()
+			requires readable
+		{ return file.template readRecord<Policy>(); }
+
+		size_t read(std::span<const iovec> buffers)
+			requires readable
+		{ return file.read(buffers); }
+		std::optional<size_t> read(std::span<const iovec> buffers, off_t offset, File::IoFlags flags = File::IoFlags::None)
+			requires readable
+		{ return file.read(buffers, offset, flags); }
+		size_t readAt(off_t offset, char *const buffer, const size_t bytes) const
+			requires readable
+		{ return file.readAt(offset, buffer, bytes); }
+		size_t readAt(off_t offset, std::span<char> buffer) const
+			requires readable
+		{ return file.readAt(offset, buffer); }
+
+		// The copy is read from this file and written to dst
+		template <File::Access Other>
+		size_t copyTo(TypedFile<Other> &dst, off_t offset = 0, size_t bytes = SIZE_MAX)
+			requires readable && TypedFile<Other>::writable
+		{ return file.copyTo(dst.get(), offset, bytes); }
+		size_t sendTo(int socketFd, off_t offset = 0, size_t bytes = SIZE_MAX)
+			requires readable
+		{ return file.sendTo(socketFd, offset, bytes); }
+
+		TypedFile &write(const std::string &data)
+			requires writable
+		{
+			file.write(data);
+			return *this;
+		}
+		TypedFile &write(const char *const data, const size_t bytes)
+			requires writable
+		{
+			file.write(data, bytes);
+			return *this;
+		}
+		TypedFile &write(std::span<const iovec> buffers)
+			requires writable
+		{
+			file.write(buffers);
+			return *this;
+		}
+		TypedFile &write(std::initializer_list<std::string_view> buffers)
+			requires writable
+		{
+			file.write(buffers);
+			return *this;
+		}
+		std::optional<size_t> write(std::span<const iovec> buffers, off_t offset, File::IoFlags flags = File::IoFlags::None)
+			requires writable
+		{ return file.write(buffers, offset, flags); }
+		const TypedFile &writeAt(off_t offset, const char *const data, const size_t bytes) const
+			requires writable
+		{
+			file.writeAt(offset, data, bytes);
+			return *this;
+		}
+		const TypedFile &writeAt(off_t offset, std::string_view data) const
+			requires writable
+		{
+			file.writeAt(offset, data);
+			return *this;
+		}
+
+		void setWriteBufferSize(size_t bytes, size_t highWaterMark = 0)
+			requires writable
+		{ file.setWriteBufferSize(bytes, highWaterMark); }
+		TypedFile &flush()
+			requires writable
+		{
+			file.flush();
+			return *this;
+		}
+		TypedFile &sync(bool dataOnly = false)
+			requires writable
+		{
+			file.sync(dataOnly);
+			return *this;
+		}
+
+		void lock() { file.lock(); }
+		void unlock() { file.unlock(); }
+		bool try_lock() { return file.try_lock(); }
+		void lock_shared() { file.lock_shared(); }
+		void unlock_shared() { file.unlock_shared(); }
+		bool try_lock_shared() { return file.try_lock_shared(); }
+
+		// fcntl(2) wants a read descriptor for shared range locks and a write descriptor for exclusive ones
+		void lockRange(off_t offset, off_t bytes, bool shared = !writable)
+		{ file.lockRange(offset, bytes, shared); }
+		bool tryLockRange(off_t offset, off_t bytes, bool shared = !writable)
+		{ return file.tryLockRange(offset, bytes, shared); }
+		void unlockRange(off_t offset, off_t bytes) { file.unlockRange(offset, bytes); }
+	};
+
+	using ReadFile = TypedFile<File::Access::ReadOnly>;
+	using WriteFile = TypedFile<File::Access::WriteOnly>;
+	using ReadWriteFile = TypedFile<File::Access::ReadWrite>;
+} // namespace Gerk
+
+#endif // INCLUDE_GERK_TYPED_FILE